@@ -1,155 +1,214 @@
 #include "Edge.h"
-#include "HalfEdge.h"
-#include "Vertex.h"
-#include "Face.h"
+#include "Mesh.h"
+#include <algorithm>
 
-bool Edge::operator<(const Edge& e) const
+VertexStamps::VertexStamps():
+generation(0)
 {
-    return cost > e.cost;
+    
 }
 
-double error(const Eigen::Matrix4d& quadric, const double x, const double y, const double z)
+void VertexStamps::advance(size_t n)
 {
-    return quadric(0, 0)*x*x + 2*quadric(0, 1)*x*y + 2*quadric(0, 2)*x*z + 2*quadric(0, 3)*x +
-           quadric(1, 1)*y*y + 2*quadric(1, 2)*y*z + 2*quadric(1, 3)*y +
-           quadric(2, 2)*z*z + 2*quadric(2, 3)*z +
-           quadric(3, 3);
+    if (stamps.size() < n) stamps.resize(n, 0);
+    if (++generation == 0) {
+        std::fill(stamps.begin(), stamps.end(), 0);
+        generation = 1;
+    }
 }
 
-void Edge::computeCollapseCost()
+void Edge::computeCollapseCost(const Mesh& mesh)
 {
-    VertexIter v1 = he->vertex;
-    VertexIter v2 = he->flip->vertex;
-    Eigen::Matrix4d quadric = v1->quadric + v2->quadric;
-    
-    Eigen::Matrix4d quadricDel = quadric;
-    quadricDel.row(3).setZero();
-    quadricDel(3, 3) = 1;
-    
-    // check if matrix is invertible
-    if (fabs(quadricDel.determinant()) > 1e-6) {
-        Eigen::Vector4d b;
-        b << 0, 0, 0, 1;
-        
-        Eigen::Vector4d x = quadricDel.inverse() * b;
-        position << x.x(), x.y(), x.z();
-        cost = fmax(0.0, error(quadric, position.x(), position.y(), position.z()));
+    HalfEdgeHandle he = mesh.he(EdgeHandle(index));
+    const Vertex& v1 = mesh.vertices[mesh.vertex(he).index];
+    const Vertex& v2 = mesh.vertices[mesh.vertex(mesh.flip(he)).index];
+    Quadric quadric = v1.quadric + v2.quadric;
+    
+    Eigen::Vector3d p;
+    if (quadric.minimize(p)) {
+        cost = fmax(0.0, quadric.evaluate(p));
         
     } else {
-        const Eigen::Vector3d& p1 = v1->position;
-        const Eigen::Vector3d& p2 = v2->position;
-        const Eigen::Vector3d& p3 = (v1->position + v2->position) * 0.5;
+        const Eigen::Vector3d p1 = v1.position.cast<double>();
+        const Eigen::Vector3d p2 = v2.position.cast<double>();
+        const Eigen::Vector3d p3 = (p1 + p2) * 0.5;
         
-        double e1 = error(quadric, p1.x(), p1.y(), p1.z());
-        double e2 = error(quadric, p2.x(), p2.y(), p2.z());
-        double e3 = error(quadric, p3.x(), p3.y(), p3.z());
+        double e1 = quadric.evaluate(p1);
+        double e2 = quadric.evaluate(p2);
+        double e3 = quadric.evaluate(p3);
         
         if (e1 < e2 && e2 < e3) {
             cost = fmax(0.0, e1);
-            position = p1;
+            p = p1;
             
         } else if (e2 < e3) {
             cost = fmax(0.0, e2);
-            position = p2;
+            p = p2;
             
         } else {
             cost = fmax(0.0, e3);
-            position = p3;
+            p = p3;
         }
     }
+    
+    position = p.cast<Scalar>();
 }
 
-bool Edge::validCollapse() const
+bool Edge::validCollapse(const Mesh& mesh, VertexStamps& stamps) const
 {
-    HalfEdgeCIter flip = he->flip;
-    
-    VertexCIter v1 = he->vertex;
-    VertexCIter v2 = flip->vertex;
-    VertexCIter v3 = he->next->next->vertex;
-    VertexCIter v4 = flip->next->next->vertex;
+    HalfEdgeHandle he = mesh.he(EdgeHandle(index));
+    HalfEdgeHandle flip = mesh.flip(he);
+    bool heBoundary = mesh.halfEdges[he.index].onBoundary;
+    bool flipBoundary = mesh.halfEdges[flip.index].onBoundary;
+    
+    // vertices opposite the edge in its triangles, invalid on a boundary side
+    VertexHandle v1 = mesh.vertex(he);
+    VertexHandle v2 = mesh.vertex(flip);
+    VertexHandle v3 = heBoundary ? VertexHandle() : mesh.vertex(mesh.next(mesh.next(he)));
+    VertexHandle v4 = flipBoundary ? VertexHandle() : mesh.vertex(mesh.next(mesh.next(flip)));
+    
+    const Vertex& a = mesh.vertices[v1.index];
+    const Vertex& b = mesh.vertices[v2.index];
+    if (a.locked || b.locked) return false;
+    if (mesh.boundaryWeight <= 0 && (a.boundary || b.boundary)) return false;
+    
+    if (heBoundary || flipBoundary) {
+        // a boundary cycle of three edges would degenerate
+        HalfEdgeHandle h = heBoundary ? he : flip;
+        if (mesh.next(mesh.next(mesh.next(h))) == h) return false;
+        
+    } else if (a.boundary && b.boundary) {
+        // an interior edge between two boundary vertices would pinch the surface
+        return false;
+    }
     
-    if (v1->onBoundary() || v2->onBoundary()) return false;
+    // stamp the one ring of v2 with a fresh generation
+    stamps.advance(mesh.vertices.size());
+    HalfEdgeHandle h = flip;
+    do {
+        stamps.stamps[mesh.vertex(mesh.flip(h)).index] = stamps.generation;
+        
+        h = mesh.next(mesh.flip(h));
+    } while (h != flip);
     
-    // check for one ring intersection
-    HalfEdgeCIter h = he;
+    // link condition, the only vertices both one rings share are v3 and v4
+    h = he;
     do {
-        VertexCIter v = h->flip->vertex;
-        if (v != v2 && v != v3 && v != v4) {
-            if (v->shareEdge(v2)) return false;
-        }
+        VertexHandle v = mesh.vertex(mesh.flip(h));
+        if (v != v3 && v != v4 && stamps.stamps[v.index] == stamps.generation) return false;
         
-        h = h->flip->next;
+        h = mesh.next(mesh.flip(h));
     } while (h != he);
     
     return true;
 }
 
-void Edge::collapse()
+// returns the halfedge before h in its face. Interior faces are triangles, boundary
+// faces are walked around the vertex at the tail of h
+HalfEdgeHandle previous(const Mesh& mesh, HalfEdgeHandle h)
 {
-    HalfEdgeIter heNext = he->next;
-    HalfEdgeIter heNextNext = heNext->next;
-    
-    HalfEdgeIter flip = he->flip;
-    HalfEdgeIter flipNext = flip->next;
-    HalfEdgeIter flipNextNext = flipNext->next;
+    if (!mesh.halfEdges[h.index].onBoundary) return mesh.next(mesh.next(h));
     
-    VertexIter v1 = he->vertex;
-    VertexIter v2 = flip->vertex;
-    VertexIter v3 = heNextNext->vertex;
-    VertexIter v4 = flipNextNext->vertex;
+    HalfEdgeHandle p = mesh.flip(h);
+    while (mesh.next(p) != h) p = mesh.flip(mesh.next(p));
     
-    EdgeIter e2 = heNextNext->edge;
-    EdgeIter e3 = flipNext->edge;
-    
-    FaceIter f = he->face;
-    FaceIter fFlip = flip->face;
+    return p;
+}
+
+// takes the place of removed in its face with kept
+void replaceHalfEdge(Mesh& mesh, HalfEdgeHandle kept, HalfEdgeHandle removed, HalfEdgeHandle removedPrev)
+{
+    mesh.face(kept) = mesh.face(removed);
+    if (mesh.he(mesh.face(kept)) == removed) mesh.he(mesh.face(kept)) = kept;
+    mesh.next(kept) = mesh.next(removed);
+    mesh.next(removedPrev) = kept;
+    mesh.halfEdges[kept.index].onBoundary = mesh.halfEdges[removed.index].onBoundary;
+}
+
+int Edge::collapse(Mesh& mesh)
+{
+    HalfEdgeHandle he = mesh.he(EdgeHandle(index));
+    HalfEdgeHandle heNext = mesh.next(he);
+    HalfEdgeHandle heNextNext = mesh.next(heNext);
+    
+    HalfEdgeHandle flip = mesh.flip(he);
+    HalfEdgeHandle flipNext = mesh.next(flip);
+    HalfEdgeHandle flipNextNext = mesh.next(flipNext);
+    
+    bool heBoundary = mesh.halfEdges[he.index].onBoundary;
+    bool flipBoundary = mesh.halfEdges[flip.index].onBoundary;
+    
+    VertexHandle v1 = mesh.vertex(he);
+    VertexHandle v2 = mesh.vertex(flip);
+    VertexHandle v3 = mesh.vertex(heNextNext);
+    VertexHandle v4 = mesh.vertex(flipNextNext);
+    
+    // halfedges before the ones that are unlinked, found while connectivity is intact.
+    // The sides are then updated in order, so a side reads links the other one set
+    HalfEdgeHandle hePrev, flipPrev;
+    if (heBoundary) hePrev = previous(mesh, he);
+    else hePrev = previous(mesh, mesh.flip(heNextNext));
+    if (flipBoundary) flipPrev = previous(mesh, flip);
+    else flipPrev = previous(mesh, mesh.flip(flipNext));
     
     // set halfEdge vertex
-    HalfEdgeIter h = flip;
+    HalfEdgeHandle h = flip;
     do {
-        h->vertex = v1;
+        mesh.vertex(h) = v1;
         
-        h = h->flip->next;
+        h = mesh.next(mesh.flip(h));
     } while (h != flip);
     
-    // set vertex halfEdge
-    v1->he = heNext;
-    v3->he = heNextNext->flip->next;
-    v4->he = flipNextNext;
-    
-    // set halfEdge face and face halfEdge
-    heNext->face = heNextNext->flip->face;
-    heNext->face->he = heNext;
-    
-    flipNextNext->face = flipNext->flip->face;
-    flipNextNext->face->he = flipNextNext;
+    // remove the triangle on each side, or unlink the edge from its boundary cycle.
+    // Faces only move off halfedges that are removed, so faces moved beforehand by
+    // Mesh::moveFacesOff are not written
+    if (heBoundary) {
+        mesh.next(hePrev) = mesh.next(he);
+        if (mesh.he(mesh.face(he)) == he) mesh.he(mesh.face(he)) = mesh.next(he);
+        mesh.he(v1) = mesh.flip(flipNextNext);
+        
+    } else {
+        mesh.he(v1) = heNext;
+        mesh.he(v3) = mesh.next(mesh.flip(heNextNext));
+        replaceHalfEdge(mesh, heNext, mesh.flip(heNextNext), hePrev);
+        
+        mesh.faces[mesh.face(he).index].remove = true;
+        mesh.edges[mesh.edge(heNextNext).index].remove = true;
+        mesh.halfEdges[heNextNext.index].remove = true;
+        mesh.halfEdges[mesh.flip(heNextNext).index].remove = true;
+    }
     
-    // set next halfEdge
-    heNext->next = heNextNext->flip->next;
-    heNext->next->next->next = heNext;
+    if (flipBoundary) {
+        mesh.next(flipPrev) = mesh.next(flip);
+        if (mesh.he(mesh.face(flip)) == flip) mesh.he(mesh.face(flip)) = mesh.next(flip);
+        
+    } else {
+        mesh.he(v4) = flipNextNext;
+        replaceHalfEdge(mesh, flipNextNext, mesh.flip(flipNext), flipPrev);
+        
+        mesh.faces[mesh.face(flip).index].remove = true;
+        mesh.edges[mesh.edge(flipNext).index].remove = true;
+        mesh.halfEdges[flipNext.index].remove = true;
+        mesh.halfEdges[mesh.flip(flipNext).index].remove = true;
+    }
     
-    flipNextNext->next = flipNext->flip->next;
-    flipNextNext->next->next->next = flipNextNext;
+    // merged vertex touches every boundary either vertex did
+    if (mesh.vertices[v2.index].boundary) mesh.vertices[v1.index].boundary = true;
     
     // mark for deletion
-    v2->remove = true;
+    mesh.vertices[v2.index].remove = true;
     remove = true;
-    e2->remove = true;
-    e3->remove = true;
-    he->remove = true;
-    flip->remove = true;
-    heNextNext->remove = true;
-    heNextNext->flip->remove = true;
-    flipNext->remove = true;
-    flipNext->flip->remove = true;
-    f->remove = true;
-    fFlip->remove = true;
+    mesh.halfEdges[he.index].remove = true;
+    mesh.halfEdges[flip.index].remove = true;
+    
+    return (heBoundary ? 0 : 1) + (flipBoundary ? 0 : 1);
 }
 
-double Edge::length() const
+double Edge::length(const Mesh& mesh) const
 {
-    const Eigen::Vector3d& a = he->vertex->position;
-    const Eigen::Vector3d& b = he->flip->vertex->position;
+    HalfEdgeHandle he = mesh.he(EdgeHandle(index));
+    const Vector3s& a = mesh.vertices[mesh.vertex(he).index].position;
+    const Vector3s& b = mesh.vertices[mesh.vertex(mesh.flip(he)).index].position;
     
-    return (b - a).norm();
+    return (b - a).cast<double>().norm();
 }
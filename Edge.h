@@ -3,11 +3,23 @@
 
 #include "Types.h"
 
-class Edge {
+// vertex stamps for one ring tests. Each thread validating collapses owns one, so
+// that a new generation replaces clearing the stamps between tests
+class VertexStamps {
 public:
-    // one of the two half edges associated with this edge
-    HalfEdgeIter he;
+    // constructor
+    VertexStamps();
+    
+    // starts a new generation over n vertices, stamps of older ones no longer match
+    void advance(size_t n);
     
+    // member variables
+    std::vector<uint32_t> stamps;
+    uint32_t generation;
+};
+
+class Edge {
+public:
     // id between 0 and |E|-1
     int index;
     
@@ -17,26 +29,23 @@ public:
     // collapse cost
     double cost;
     
-    // vertex position after collapse
-    Eigen::Vector3d position;
-    
-    // heap handle
-    boost::heap::fibonacci_heap<Edge>::handle_type handle;
+    // incremented when a neighboring collapse leaves cost stale
+    uint32_t version;
     
-    // comparator
-    bool operator<(const Edge& e) const;
+    // vertex position after collapse
+    Vector3s position;
     
     // computes edge collapse cost
-    void computeCollapseCost();
+    void computeCollapseCost(const Mesh& mesh);
     
-    // checks if collapse is valid
-    bool validCollapse() const;
+    // checks if collapse is valid, stamping one ring vertices in stamps
+    bool validCollapse(const Mesh& mesh, VertexStamps& stamps) const;
     
-    // collapses edge
-    void collapse();
+    // collapses edge, returns the number of faces removed (one for boundary edges)
+    int collapse(Mesh& mesh);
     
     // computes edge length
-    double length() const;
+    double length(const Mesh& mesh) const;
 };
 
 #endif
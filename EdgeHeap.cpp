@@ -0,0 +1,155 @@
+#include "EdgeHeap.h"
+#include "Edge.h"
+
+#define ARITY 4
+#define NOT_IN_HEAP 0xffffffff
+
+void EdgeHeap::build(const std::vector<Edge>& edges)
+{
+    nodes.resize(edges.size());
+    positions.assign(edges.size(), NOT_IN_HEAP);
+    
+    uint32_t n = 0;
+    for (EdgeCIter e = edges.begin(); e != edges.end(); e++) {
+        if (!e->remove) place(Node(e->cost, (uint32_t)e->index, e->version), n++);
+    }
+    nodes.resize(n);
+    
+    // heapify bottom up
+    if (n > 1) {
+        for (uint32_t i = (n - 2) / ARITY + 1; i-- > 0;) {
+            siftDown(i);
+        }
+    }
+}
+
+bool EdgeHeap::empty() const
+{
+    return nodes.empty();
+}
+
+int EdgeHeap::size() const
+{
+    return (int)nodes.size();
+}
+
+bool EdgeHeap::contains(EdgeHandle e) const
+{
+    return e.index < positions.size() && positions[e.index] != NOT_IN_HEAP;
+}
+
+EdgeHandle EdgeHeap::top() const
+{
+    return EdgeHandle(nodes[0].edge);
+}
+
+double EdgeHeap::topCost() const
+{
+    return nodes[0].cost;
+}
+
+uint32_t EdgeHeap::topVersion() const
+{
+    return nodes[0].version;
+}
+
+void EdgeHeap::pop()
+{
+    remove(top());
+}
+
+void EdgeHeap::push(EdgeHandle e, double cost, uint32_t version)
+{
+    if (contains(e)) {
+        update(e, cost, version);
+        return;
+    }
+    
+    if (e.index >= positions.size()) positions.resize(e.index + 1, NOT_IN_HEAP);
+    
+    uint32_t i = (uint32_t)nodes.size();
+    nodes.push_back(Node(cost, e.index, version));
+    positions[e.index] = i;
+    siftUp(i);
+}
+
+void EdgeHeap::update(EdgeHandle e, double cost, uint32_t version)
+{
+    uint32_t i = positions[e.index];
+    Node& node = nodes[i];
+    node.version = version;
+    
+    if (cost < node.cost) {
+        node.cost = cost;
+        siftUp(i);
+        
+    } else {
+        node.cost = cost;
+        siftDown(i);
+    }
+}
+
+void EdgeHeap::remove(EdgeHandle e)
+{
+    uint32_t i = positions[e.index];
+    positions[e.index] = NOT_IN_HEAP;
+    
+    // fill the hole with the last node and restore heap order
+    Node last = nodes.back();
+    nodes.pop_back();
+    if (i < nodes.size()) {
+        place(last, i);
+        if (i > 0 && last < nodes[(i - 1) / ARITY]) siftUp(i);
+        else siftDown(i);
+    }
+}
+
+void EdgeHeap::clear()
+{
+    nodes.clear();
+    positions.clear();
+}
+
+void EdgeHeap::siftUp(uint32_t i)
+{
+    Node node = nodes[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / ARITY;
+        if (!(node < nodes[parent])) break;
+        
+        place(nodes[parent], i);
+        i = parent;
+    }
+    
+    place(node, i);
+}
+
+void EdgeHeap::siftDown(uint32_t i)
+{
+    Node node = nodes[i];
+    uint32_t n = (uint32_t)nodes.size();
+    while (true) {
+        // find smallest child
+        uint32_t first = ARITY * i + 1;
+        if (first >= n) break;
+        
+        uint32_t last = std::min(first + ARITY, n);
+        uint32_t child = first;
+        for (uint32_t c = first + 1; c < last; c++) {
+            if (nodes[c] < nodes[child]) child = c;
+        }
+        
+        if (!(nodes[child] < node)) break;
+        
+        place(nodes[child], i);
+        i = child;
+    }
+    
+    place(node, i);
+}
+
+void EdgeHeap::place(const Node& node, uint32_t i)
+{
+    nodes[i] = node;
+    positions[node.edge] = i;
+}
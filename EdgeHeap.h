@@ -0,0 +1,76 @@
+#ifndef EDGE_HEAP_H
+#define EDGE_HEAP_H
+
+#include "Types.h"
+
+// flat 4-ary min heap of (cost, edge, version) entries with a position map for key
+// updates. The version records which edge version the cost was computed for
+class EdgeHeap {
+public:
+    // builds heap over all edges in linear time
+    void build(const std::vector<Edge>& edges);
+    
+    // checks if heap is empty
+    bool empty() const;
+    
+    // returns number of edges in heap
+    int size() const;
+    
+    // checks if edge is in heap
+    bool contains(EdgeHandle e) const;
+    
+    // returns edge with lowest cost
+    EdgeHandle top() const;
+    
+    // returns lowest cost
+    double topCost() const;
+    
+    // returns the edge version the lowest cost was computed for
+    uint32_t topVersion() const;
+    
+    // removes edge with lowest cost
+    void pop();
+    
+    // inserts edge, or updates its cost if it is already in heap
+    void push(EdgeHandle e, double cost, uint32_t version);
+    
+    // increases or decreases edge cost
+    void update(EdgeHandle e, double cost, uint32_t version);
+    
+    // removes edge from heap
+    void remove(EdgeHandle e);
+    
+    // removes all edges
+    void clear();
+    
+private:
+    class Node {
+    public:
+        Node() {}
+        Node(double cost_, uint32_t edge_, uint32_t version_): cost(cost_), edge(edge_), version(version_) {}
+        
+        // ties are broken by edge index so that the collapse order is deterministic
+        bool operator<(const Node& n) const {
+            return cost < n.cost || (cost == n.cost && edge < n.edge);
+        }
+        
+        double cost;
+        uint32_t edge;
+        uint32_t version;
+    };
+    
+    // moves node at i towards the root
+    void siftUp(uint32_t i);
+    
+    // moves node at i towards the leaves
+    void siftDown(uint32_t i);
+    
+    // places node at i and records its position
+    void place(const Node& node, uint32_t i);
+    
+    // member variables
+    std::vector<Node> nodes;
+    std::vector<uint32_t> positions;
+};
+
+#endif
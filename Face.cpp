@@ -1,26 +1,26 @@
 #include "Face.h"
-#include "HalfEdge.h"
-#include "Vertex.h"
+#include "Mesh.h"
 
-bool Face::isBoundary() const
+bool Face::isBoundary(const Mesh& mesh) const
 {
-    return he->onBoundary;
+    return mesh.halfEdges[mesh.he(FaceHandle(index)).index].onBoundary;
 }
 
-double Face::area() const
+double Face::area(const Mesh& mesh) const
 {
-    if (isBoundary()) {
+    if (isBoundary(mesh)) {
         return 0;
     }
     
-    return 0.5 * normal().norm();
+    return 0.5 * normal(mesh).norm();
 }
 
-Eigen::Vector3d Face::normal() const
+Eigen::Vector3d Face::normal(const Mesh& mesh) const
 {
-    const Eigen::Vector3d& a = he->vertex->position;
-    const Eigen::Vector3d& b = he->next->vertex->position;
-    const Eigen::Vector3d& c = he->next->next->vertex->position;
+    HalfEdgeHandle he = mesh.he(FaceHandle(index));
+    const Eigen::Vector3d a = mesh.vertices[mesh.vertex(he).index].position.cast<double>();
+    const Eigen::Vector3d b = mesh.vertices[mesh.vertex(mesh.next(he)).index].position.cast<double>();
+    const Eigen::Vector3d c = mesh.vertices[mesh.vertex(mesh.next(mesh.next(he))).index].position.cast<double>();
     
     Eigen::Vector3d v1 = b - a;
     Eigen::Vector3d v2 = c - a;
@@ -28,11 +28,11 @@ Eigen::Vector3d Face::normal() const
     return v1.cross(v2);
 }
 
-Eigen::Vector4d Face::plane() const
+Eigen::Vector4d Face::plane(const Mesh& mesh) const
 {
-    const Eigen::Vector3d& a = he->vertex->position;
+    const Eigen::Vector3d a = mesh.vertices[mesh.vertex(mesh.he(FaceHandle(index))).index].position.cast<double>();
     
-    Eigen::Vector3d n = normal();
+    Eigen::Vector3d n = normal(mesh);
     n.normalize();
         
     Eigen::Vector4d p;
@@ -5,9 +5,6 @@
 
 class Face {
 public:
-    // one of the halfedges associated with this face
-    HalfEdgeIter he;
-    
     // id between 0 and |F|-1
     int index;
     
@@ -15,16 +12,16 @@ public:
     bool remove;
     
     // checks if this face lies on boundary
-    bool isBoundary() const;
+    bool isBoundary(const Mesh& mesh) const;
     
     // returns face area
-    double area() const;
+    double area(const Mesh& mesh) const;
     
     // returns normal to face
-    Eigen::Vector3d normal() const;
+    Eigen::Vector3d normal(const Mesh& mesh) const;
     
     // returns equation of a plane
-    Eigen::Vector4d plane() const;
+    Eigen::Vector4d plane(const Mesh& mesh) const;
 };
 
 #endif
@@ -5,26 +5,11 @@
 
 class HalfEdge {
 public:
-    // next halfedge around the current face
-    HalfEdgeIter next;
-    
-    // other halfedge associated with this edge
-    HalfEdgeIter flip;
-    
-    // vertex at the tail of the halfedge
-    VertexIter vertex;
-    
-    // edge associated with this halfedge
-    EdgeIter edge;
-    
-    // face associated with this halfedge
-    FaceIter face;
-    
     // uv associated with vertex at tail of halfedge
-    Eigen::Vector3d uv;
+    Vector3s uv;
     
     // normal associated with vertex at tail of halfedge
-    Eigen::Vector3d normal;
+    Vector3s normal;
     
     // checks if this halfedge is contained in boundary loop
     bool onBoundary;
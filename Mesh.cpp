@@ -1,27 +1,98 @@
 #include "Mesh.h"
 #include "MeshIO.h"
+#include "Parallel.h"
+#include "Timer.h"
+#include <algorithm>
 
-Mesh::Mesh()
+Mesh::Mesh():
+threads(0),
+validationLevel(VALIDATION_FAST),
+recordCollapses(false),
+keepRemoved(false),
+clusterFactor(0),
+boundaryWeight(100),
+progressInterval(0.5)
 {
     
 }
 
-Mesh::Mesh(const Mesh& mesh)
+void Mesh::snapshot(MeshSnapshot& snapshot) const
 {
-    *this = mesh;
+    snapshot.halfEdges = halfEdges;
+    snapshot.vertices = vertices;
+    snapshot.uvs = uvs;
+    snapshot.normals = normals;
+    snapshot.edges = edges;
+    snapshot.faces = faces;
+    snapshot.boundaries = boundaries;
+    snapshot.heNext = heNext;
+    snapshot.heFlip = heFlip;
+    snapshot.heVertex = heVertex;
+    snapshot.heEdge = heEdge;
+    snapshot.heFace = heFace;
+    snapshot.vertexHe = vertexHe;
+    snapshot.edgeHe = edgeHe;
+    snapshot.faceHe = faceHe;
+    snapshot.freeHalfEdges = freeHalfEdges;
+    snapshot.freeVertices = freeVertices;
+    snapshot.freeEdges = freeEdges;
+    snapshot.freeFaces = freeFaces;
 }
 
-bool Mesh::read(const std::string& fileName)
+void Mesh::restore(const MeshSnapshot& snapshot)
 {
-    std::ifstream in(fileName.c_str());
+    halfEdges = snapshot.halfEdges;
+    vertices = snapshot.vertices;
+    uvs = snapshot.uvs;
+    normals = snapshot.normals;
+    edges = snapshot.edges;
+    faces = snapshot.faces;
+    boundaries = snapshot.boundaries;
+    heNext = snapshot.heNext;
+    heFlip = snapshot.heFlip;
+    heVertex = snapshot.heVertex;
+    heEdge = snapshot.heEdge;
+    heFace = snapshot.heFace;
+    vertexHe = snapshot.vertexHe;
+    edgeHe = snapshot.edgeHe;
+    faceHe = snapshot.faceHe;
+    
+    freeHalfEdges = snapshot.freeHalfEdges;
+    freeVertices = snapshot.freeVertices;
+    freeEdges = snapshot.freeEdges;
+    freeFaces = snapshot.freeFaces;
+    heap.clear();
+}
 
-    if (!in.is_open()) {
-        std::cerr << "Error: Could not open file for reading" << std::endl;
-        return false;
+// returns lower case file extension without the dot
+std::string fileExtension(const std::string& fileName)
+{
+    size_t dot = fileName.find_last_of('.');
+    if (dot == std::string::npos) return "";
+    
+    std::string extension = fileName.substr(dot + 1);
+    for (size_t i = 0; i < extension.size(); i++) {
+        extension[i] = (char)tolower(extension[i]);
     }
     
+    return extension;
+}
+
+bool Mesh::read(const std::string& fileName)
+{
     bool readSuccessful = false;
-    if ((readSuccessful = MeshIO::read(in, *this))) {
+    std::string extension = fileExtension(fileName);
+    if (extension == "smesh") {
+        readSuccessful = MeshIO::readBinary(fileName, *this);
+        
+    } else if (extension == "ply") {
+        readSuccessful = MeshIO::readPly(fileName, *this);
+        
+    } else {
+        readSuccessful = MeshIO::read(fileName, *this);
+    }
+    
+    if (readSuccessful) {
         normalize();
     }
     
@@ -30,6 +101,20 @@ bool Mesh::read(const std::string& fileName)
 
 bool Mesh::write(const std::string& fileName) const
 {
+    if (hasRemoved()) {
+        Mesh compacted(*this);
+        compacted.resetLists();
+        return compacted.write(fileName);
+    }
+    
+    std::string extension = fileExtension(fileName);
+    if (extension == "smesh") {
+        return MeshIO::writeBinary(fileName, *this, true);
+        
+    } else if (extension == "ply") {
+        return MeshIO::writePly(fileName, *this);
+    }
+    
     std::ofstream out(fileName.c_str());
     
     if (!out.is_open()) {
@@ -39,182 +124,862 @@ bool Mesh::write(const std::string& fileName) const
     
     MeshIO::write(out, *this);
     
-    return false;
+    return true;
 }
 
-Eigen::Matrix4d computeQuadric(const Eigen::Vector4d& plane)
+// returns a slot from the free list, or appends one to vec
+template <typename T>
+Handle<T> allocate(std::vector<T>& vec, std::vector<Handle<T>>& slots)
 {
-    double a = plane[0];
-    double b = plane[1];
-    double c = plane[2];
-    double d = plane[3];
+    if (slots.empty()) {
+        vec.push_back(T());
+        return Handle<T>((uint32_t)vec.size() - 1);
+    }
     
-    Eigen::Matrix4d quadric;
-    quadric << a*a, a*b, a*c, a*d,
-               b*a, b*b, b*c, b*d,
-               c*a, c*b, c*c, c*d,
-               d*a, d*b, d*c, d*d;
+    Handle<T> h = slots.back();
+    slots.pop_back();
+    vec[h.index] = T();
     
-    return quadric;
+    return h;
+}
+
+// appends an unset link unless h reuses an existing slot
+template <typename T, typename U>
+void resetLink(std::vector<Handle<T>>& links, Handle<U> h)
+{
+    if (h.index == links.size()) links.push_back(Handle<T>());
+    else links[h.index] = Handle<T>();
+}
+
+HalfEdgeHandle Mesh::newHalfEdge()
+{
+    HalfEdgeHandle h = allocate(halfEdges, freeHalfEdges);
+    halfEdges[h.index].index = (int)h.index;
+    halfEdges[h.index].onBoundary = false;
+    halfEdges[h.index].remove = false;
+    
+    resetLink(heNext, h);
+    resetLink(heFlip, h);
+    resetLink(heVertex, h);
+    resetLink(heEdge, h);
+    resetLink(heFace, h);
+    
+    return h;
+}
+
+VertexHandle Mesh::newVertex()
+{
+    VertexHandle v = allocate(vertices, freeVertices);
+    vertices[v.index].index = (int)v.index;
+    vertices[v.index].remove = false;
+    vertices[v.index].locked = false;
+    vertices[v.index].boundary = false;
+    resetLink(vertexHe, v);
+    
+    return v;
+}
+
+EdgeHandle Mesh::newEdge()
+{
+    EdgeHandle e = allocate(edges, freeEdges);
+    edges[e.index].index = (int)e.index;
+    edges[e.index].remove = false;
+    resetLink(edgeHe, e);
+    
+    return e;
+}
+
+FaceHandle Mesh::newFace()
+{
+    FaceHandle f = allocate(faces, freeFaces);
+    faces[f.index].index = (int)f.index;
+    faces[f.index].remove = false;
+    resetLink(faceHe, f);
+    
+    return f;
 }
 
 void Mesh::computeQuadrics()
 {
-    for (VertexIter v = vertices.begin(); v != vertices.end(); v++) {
-        v->quadric.setZero();
-    }
+    // compute face planes
+    std::vector<Eigen::Vector4d, Eigen::aligned_allocator<Eigen::Vector4d>> planes(faces.size());
+    parallelFor(0, (int)faces.size(), threads, [&](int i) {
+        if (!faces[i].isBoundary(*this)) {
+            planes[i] = faces[i].plane(*this);
+        }
+    });
     
-    for (FaceCIter f = faces.begin(); f != faces.end(); f++) {
-        if (!f->isBoundary()) {
-            Eigen::Vector4d plane = f->plane();
+    // gather plane quadrics over each vertex's one ring, so that every vertex
+    // is written by exactly one thread and summation order is fixed
+    parallelFor(0, (int)vertices.size(), threads, [&](int i) {
+        Quadric& quadric = vertices[i].quadric;
+        quadric.setZero();
+        
+        HalfEdgeHandle vHe = vertexHe[i];
+        if (!vHe.isValid()) return;
+        
+        HalfEdgeHandle h = vHe;
+        do {
+            if (!halfEdges[h.index].onBoundary) {
+                quadric += Quadric(planes[face(h).index]);
+            }
             
-            HalfEdgeCIter he = f->he;
-            do {
-                VertexIter v = he->vertex;
-                v->quadric += computeQuadric(plane);
+            // boundary edges add a plane through the edge perpendicular to its face,
+            // which keeps the boundary in place as it is simplified
+            HalfEdgeHandle fHe = halfEdges[h.index].onBoundary ? flip(h) :
+                                 halfEdges[flip(h).index].onBoundary ? h : HalfEdgeHandle();
+            if (boundaryWeight > 0 && fHe.isValid()) {
+                const Eigen::Vector3d a = vertices[i].position.cast<double>();
+                const Eigen::Vector3d b = vertices[vertex(flip(h)).index].position.cast<double>();
+                Eigen::Vector3d n = (b - a).cross(planes[face(fHe).index].head<3>());
                 
-                he = he->next;
-            } while (he != f->he);
-        }
-    }
+                double norm = n.norm();
+                if (norm > 0) {
+                    n /= norm;
+                    quadric += Quadric(Eigen::Vector4d(n.x(), n.y(), n.z(), -n.dot(a)))*boundaryWeight;
+                }
+            }
+            
+            h = next(flip(h));
+        } while (h != vHe);
+    });
 }
 
 void Mesh::computeEdgeCollapseCost()
 {
-    for (EdgeIter e = edges.begin(); e != edges.end(); e++) {
-        e->computeCollapseCost();
-    }
+    parallelFor(0, (int)edges.size(), threads, [&](int i) {
+        edges[i].computeCollapseCost(*this);
+        edges[i].version = 0;
+    });
 }
 
+// number of elements each thread scans at a time when numbering live elements
+#define COMPACT_BLOCK_SIZE 4096
+
 template <typename T>
-void swapMarkedRemove(std::vector<T>& vec, int& size)
+uint32_t buildRemap(const std::vector<T>& vec, int threads, std::vector<uint32_t>& remap)
 {
     int n = (int)vec.size();
+    int nBlocks = (n + COMPACT_BLOCK_SIZE - 1) / COMPACT_BLOCK_SIZE;
+    remap.resize(n);
     
-    if (n > 0) {
-        int start = 0, end = n - 1;
-        
-        while (true) {
-            // find first removed and valid T
-            while (!vec[start].remove && start < end) start++;
-            while (vec[end].remove && start < end) end--;
-            
-            if (start >= end) break;
-            
-            // swap
-            std::swap(vec[start], vec[end]);
+    // count elements not marked for removal in each block
+    std::vector<uint32_t> offsets(nBlocks + 1, 0);
+    parallelFor(0, nBlocks, threads, [&](int b) {
+        int end = std::min(n, (b + 1)*COMPACT_BLOCK_SIZE);
+        uint32_t count = 0;
+        for (int i = b*COMPACT_BLOCK_SIZE; i < end; i++) {
+            if (!vec[i].remove) count++;
         }
-        
-        size = vec[start].remove ? start : start + 1;
+        offsets[b+1] = count;
+    }, 1);
+    
+    // prefix sum gives the first new index of each block
+    for (int b = 0; b < nBlocks; b++) {
+        offsets[b+1] += offsets[b];
     }
+    
+    // number elements in their original order
+    parallelFor(0, nBlocks, threads, [&](int b) {
+        int end = std::min(n, (b + 1)*COMPACT_BLOCK_SIZE);
+        uint32_t index = offsets[b];
+        for (int i = b*COMPACT_BLOCK_SIZE; i < end; i++) {
+            remap[i] = vec[i].remove ? 0xffffffff : index++;
+        }
+    }, 1);
+    
+    return offsets[nBlocks];
 }
 
-void Mesh::resetLists()
+template <typename T>
+void compactElements(std::vector<T>& vec, const std::vector<uint32_t>& remap, uint32_t size, int threads)
+{
+    std::vector<T> compacted(size);
+    parallelFor(0, (int)vec.size(), threads, [&](int i) {
+        if (remap[i] != 0xffffffff) {
+            compacted[remap[i]] = vec[i];
+            compacted[remap[i]].index = (int)remap[i];
+        }
+    });
+    
+    vec.swap(compacted);
+}
+
+template <typename T>
+void compactLinks(std::vector<Handle<T>>& links, const std::vector<uint32_t>& ownerRemap, uint32_t size,
+                  const std::vector<uint32_t>& remap, int threads)
 {
-    int nV, nE, nF, nHE;
+    std::vector<Handle<T>> compacted(size);
+    parallelFor(0, (int)links.size(), threads, [&](int i) {
+        if (ownerRemap[i] != 0xffffffff) {
+            Handle<T> h = links[i];
+            compacted[ownerRemap[i]] = h.isValid() ? Handle<T>(remap[h.index]) : h;
+        }
+    });
     
-    swapMarkedRemove(vertices, nV);
-    swapMarkedRemove(edges, nE);
-    swapMarkedRemove(halfEdges, nHE);
-    swapMarkedRemove(faces, nF);
+    links.swap(compacted);
+}
+
+void Mesh::resetLists()
+{
+    // map old indices to new indices, keeping element order
+    std::vector<uint32_t> vRemap, eRemap, heRemap, fRemap;
+    uint32_t nV = buildRemap(vertices, threads, vRemap);
+    uint32_t nE = buildRemap(edges, threads, eRemap);
+    uint32_t nHE = buildRemap(halfEdges, threads, heRemap);
+    uint32_t nF = buildRemap(faces, threads, fRemap);
     
-    // reassign iterators
-    for (int i = 0; i < nV; i++) {
-        if (!vertices[i].isIsolated()) {
-            vertices[i].he = halfEdges.begin() + vertices[i].he->index;
+    // boundary collapses can remove a cycle's halfedge, which is then replaced by
+    // its boundary face's halfedge
+    std::vector<HalfEdgeHandle> remainingBoundaries;
+    for (size_t i = 0; i < boundaries.size(); i++) {
+        uint32_t index = heRemap[boundaries[i].index];
+        if (index == 0xffffffff) {
+            FaceHandle f = face(boundaries[i]);
+            if (!faces[f.index].remove) index = heRemap[he(f).index];
         }
+        
+        if (index != 0xffffffff) remainingBoundaries.push_back(HalfEdgeHandle(index));
     }
+    boundaries.swap(remainingBoundaries);
     
-    for (int i = 0; i < nE; i++) {
-        edges[i].he = halfEdges.begin() + edges[i].he->index;
-    }
+    // reassign connectivity
+    compactLinks(vertexHe, vRemap, nV, heRemap, threads);
+    compactLinks(edgeHe, eRemap, nE, heRemap, threads);
+    compactLinks(heNext, heRemap, nHE, heRemap, threads);
+    compactLinks(heFlip, heRemap, nHE, heRemap, threads);
+    compactLinks(heVertex, heRemap, nHE, vRemap, threads);
+    compactLinks(heEdge, heRemap, nHE, eRemap, threads);
+    compactLinks(heFace, heRemap, nHE, fRemap, threads);
+    compactLinks(faceHe, fRemap, nF, heRemap, threads);
+    
+    // erase and reindex
+    compactElements(vertices, vRemap, nV, threads);
+    compactElements(edges, eRemap, nE, threads);
+    compactElements(halfEdges, heRemap, nHE, threads);
+    compactElements(faces, fRemap, nF, threads);
     
-    for (int i = 0; i < nHE; i++) {
-        halfEdges[i].vertex = vertices.begin() + halfEdges[i].vertex->index;
-        halfEdges[i].edge = edges.begin() + halfEdges[i].edge->index;
-        halfEdges[i].flip = halfEdges.begin() + halfEdges[i].flip->index;
-        halfEdges[i].next = halfEdges.begin() + halfEdges[i].next->index;
-        halfEdges[i].face = faces.begin() + halfEdges[i].face->index;
+    freeHalfEdges.clear();
+    freeVertices.clear();
+    freeEdges.clear();
+    freeFaces.clear();
+}
+
+template <typename T>
+void collectFreeSlots(const std::vector<T>& vec, std::vector<Handle<T>>& slots)
+{
+    slots.clear();
+    for (size_t i = 0; i < vec.size(); i++) {
+        if (vec[i].remove) slots.push_back(Handle<T>((uint32_t)i));
     }
+}
+
+void Mesh::collectRemoved()
+{
+    collectFreeSlots(halfEdges, freeHalfEdges);
+    collectFreeSlots(vertices, freeVertices);
+    collectFreeSlots(edges, freeEdges);
+    collectFreeSlots(faces, freeFaces);
+}
+
+bool Mesh::hasRemoved() const
+{
+    return !freeHalfEdges.empty() || !freeVertices.empty() || !freeEdges.empty() || !freeFaces.empty();
+}
+
+void Mesh::finishSimplification()
+{
+    Clock::time_point start = Clock::now();
+    if (keepRemoved) collectRemoved();
+    else resetLists();
     
-    for (int i = 0; i < nF; i++) {
-        faces[i].he = halfEdges.begin() + faces[i].he->index;
+    heap.clear();
+    stats.compactTime += secondsSince(start);
+}
+
+void Mesh::reportProgress()
+{
+    Clock::time_point now = Clock::now();
+    if (std::chrono::duration<double>(now - lastProgress).count() >= progressInterval) {
+        lastProgress = now;
+        progress(stats);
     }
+}
+
+void Mesh::clusterVertices(int target)
+{
+    int nF = stats.faces;
+    if (clusterFactor <= 0 || nF <= clusterFactor*target || vertices.empty()) return;
+    int clusterTarget = (int)(clusterFactor*target);
+    
+    // choose cells so that about one vertex per cell remains, with two faces per vertex
+    std::vector<double> areas(faces.size());
+    parallelFor(0, (int)faces.size(), threads, [&](int i) {
+        areas[i] = faces[i].area(*this);
+    });
+    
+    double area = 0;
+    for (size_t i = 0; i < areas.size(); i++) area += areas[i];
+    double cellSize = sqrt(area / std::max(1, clusterTarget / 2));
+    if (!(cellSize > 0)) return;
+    
+    // cell of each vertex, fixed before any vertex moves
+    Vector3s min = vertices[0].position;
+    for (size_t i = 1; i < vertices.size(); i++) min = min.cwiseMin(vertices[i].position);
     
-    // erase
-    vertices.resize(nV);
-    edges.resize(nE);
-    halfEdges.resize(nHE);
-    faces.resize(nF);
+    std::vector<uint64_t> cells(vertices.size());
+    parallelFor(0, (int)vertices.size(), threads, [&](int i) {
+        Eigen::Vector3d p = (vertices[i].position - min).cast<double>() / cellSize;
+        uint64_t x = (uint64_t)std::min(p.x(), 2097151.0);
+        uint64_t y = (uint64_t)std::min(p.y(), 2097151.0);
+        uint64_t z = (uint64_t)std::min(p.z(), 2097151.0);
+        cells[i] = (x << 42) | (y << 21) | z;
+    });
     
-    // reindex
-    MeshIO::indexElements(*this);
+    // collapse edges inside cells in memory order, without a heap. A collapse can
+    // leave an earlier edge inside a cell, so passes repeat while they make progress
+    bool progress = true;
+    for (int pass = 0; pass < 4 && progress && nF > clusterTarget; pass++) {
+        progress = false;
+        for (size_t i = 0; i < edges.size() && nF > clusterTarget; i++) {
+            Edge& e = edges[i];
+            if (e.remove) continue;
+            
+            HalfEdgeHandle eHe = he(EdgeHandle((uint32_t)i));
+            Vertex& v1 = vertices[vertex(eHe).index];
+            const Vertex& v2 = vertices[vertex(flip(eHe)).index];
+            if (cells[v1.index] != cells[v2.index] || !e.validCollapse(*this, ringStamps)) continue;
+            
+            // summed quadrics place the cell representative
+            e.computeCollapseCost(*this);
+            if (recordCollapses) progressiveMesh.recordCollapse(*this, EdgeHandle(e.index), e.position);
+            
+            v1.position = e.position;
+            v1.quadric += v2.quadric;
+            nF -= e.collapse(*this);
+            stats.clusterCollapses++;
+            progress = true;
+        }
+    }
+    
+    stats.faces = nF;
 }
 
-void Mesh::simplify(int target)
+void Mesh::prepareSimplification(int target, bool cluster)
 {
+    // slots kept by an earlier simplification hold stale connectivity
+    if (hasRemoved()) resetLists();
+    
+    stats.clear();
+    stats.initialFaces = stats.faces = (int)faces.size();
+    lastProgress = Clock::now();
+    
+    // collapses can only be recorded on triangle meshes
+    if (recordCollapses && !progressiveMesh.build(*this)) {
+        std::cerr << "Warning: not recording collapses, mesh has faces that are not triangles" << std::endl;
+        recordCollapses = false;
+    }
+    
     // 1
+    Clock::time_point start = Clock::now();
     computeQuadrics();
+    stats.quadricTime = secondsSince(start);
+    
+    start = Clock::now();
+    if (cluster) clusterVertices(target);
+    stats.clusterTime = secondsSince(start);
     
     // 2
+    start = Clock::now();
     computeEdgeCollapseCost();
+    stats.costTime = secondsSince(start);
+    stats.costRecomputes = (int)edges.size();
 
     // 3
-    for (EdgeIter e = edges.begin(); e != edges.end(); e++) {
-        boost::heap::fibonacci_heap<Edge>::handle_type h = heap.push(*e);
-        handles.push_back(h);
-        (*h).handle = h;
-    }
+    start = Clock::now();
+    heap.build(edges);
+    rejectedAround.assign(vertices.size(), 0);
+    stats.heapTime = secondsSince(start);
+}
+
+void Mesh::collapseEdges(int target, double maxError)
+{
+    std::vector<EdgeHandle> rejected;
     
-    // 4
-    int nF = (int)faces.size();
-    while (nF > target) {
-        const Edge& minE = heap.top();
-        EdgeIter e = edges.begin() + minE.index;
+    Clock::time_point start = Clock::now();
+    int& nF = stats.faces;
+    while (nF > target && !heap.empty() && heap.topCost() <= maxError) {
+        EdgeIter e = edges.begin() + heap.top().index;
+        
+        if (e->remove) {
+            heap.pop();
+            stats.stalePops++;
         
-        if (!e->remove && e->validCollapse()) {
-            VertexIter v1 = e->he->vertex;
-            VertexIter v2 = e->he->flip->vertex;
+        } else if (heap.topVersion() != e->version) {
+            // a neighboring collapse left the cost stale, recompute it now that the
+            // edge is due and let the heap reorder
+            e->computeCollapseCost(*this);
+            heap.update(EdgeHandle(e->index), e->cost, e->version);
+            stats.costRecomputes++;
+            stats.heapUpdates++;
+        
+        } else if (!e->validCollapse(*this, ringStamps)) {
+            rejectEdge(EdgeHandle(e->index));
+            stats.rejectedCollapses++;
+        
+        } else {
+            HalfEdgeHandle eHe = he(EdgeHandle(e->index));
+            Vertex& v1 = vertices[vertex(eHe).index];
+            const Vertex& v2 = vertices[vertex(flip(eHe)).index];
+            double cost = e->cost;
+            heap.pop();
+            
+            if (recordCollapses) progressiveMesh.recordCollapse(*this, EdgeHandle(e->index), e->position);
             
             // update vertex position and quadric
-            v1->position = e->position;
-            v1->quadric = v1->quadric + v2->quadric;
+            v1.position = e->position;
+            v1.quadric += v2.quadric;
+            
+            // the collapse removes one edge of each adjacent triangle besides e
+            EdgeHandle sides[4] = {edge(next(eHe)), edge(next(next(eHe))),
+                                   edge(next(flip(eHe))), edge(next(next(flip(eHe))))};
             
             // collapse edge
-            e->collapse();
+            rejectedAround[v1.index] |= rejectedAround[v2.index];
+            int removedFaces = e->collapse(*this);
+            
+            // drop removed edges now, while they sit deep in the heap, instead of
+            // popping them from the top later
+            for (int i = 0; i < 4; i++) {
+                if (edges[sides[i].index].remove && heap.contains(sides[i])) heap.remove(sides[i]);
+            }
             
-            // update edge collapse cost
-            HalfEdgeIter he = v1->he;
+            // mark edge collapse costs stale, they are recomputed when the edges reach the top
+            HalfEdgeHandle v1He = he(VertexHandle(v1.index));
+            HalfEdgeHandle h = v1He;
             do {
-                EdgeIter e = he->edge;
-                e->computeCollapseCost();
-                (*handles[e->index]).cost = e->cost;
-                heap.update(handles[e->index]);
+                edges[edge(h).index].version++;
                 
-                he = he->flip->next;
-            } while (he != v1->he);
+                h = next(flip(h));
+            } while (h != v1He);
             
-            nF -= 2;
-            std::cout << "nF: " << nF << std::endl;
+            // re-queue rejected edges whose neighborhood changed
+            rejected.clear();
+            collectRejected(VertexHandle(v1.index), rejected);
+            for (size_t i = 0; i < rejected.size(); i++) {
+                if (heap.contains(rejected[i])) continue;
+                
+                Edge& r = edges[rejected[i].index];
+                r.computeCollapseCost(*this);
+                heap.push(rejected[i], r.cost, r.version);
+                stats.costRecomputes++;
+                stats.heapUpdates++;
+            }
+            
+            nF -= removedFaces;
+            stats.collapses++;
+            stats.lastError = cost;
+            stats.maxError = std::max(stats.maxError, cost);
+            if (progress) reportProgress();
+        }
+    }
+    
+    stats.collapseTime += secondsSince(start);
+}
+
+void Mesh::copyLod(Mesh& lod)
+{
+    Clock::time_point start = Clock::now();
+    MeshSnapshot elements;
+    snapshot(elements);
+    lod.restore(elements);
+    
+    lod.threads = threads;
+    lod.validationLevel = validationLevel;
+    lod.keepRemoved = keepRemoved;
+    lod.clusterFactor = clusterFactor;
+    lod.boundaryWeight = boundaryWeight;
+    lod.stats = stats;
+    lod.finishSimplification();
+    stats.compactTime += secondsSince(start);
+}
+
+void Mesh::simplify(int target)
+{
+    prepareSimplification(target, true);
+    
+    // 4
+    collapseEdges(target, INFINITY);
+    
+    // clean up
+    finishSimplification();
+}
+
+// returns indices of values sorted so that the earliest reached threshold comes first
+template <typename T>
+std::vector<int> thresholdOrder(const std::vector<T>& values, bool decreasing)
+{
+    std::vector<int> order(values.size());
+    for (int i = 0; i < (int)order.size(); i++) order[i] = i;
+    
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return decreasing ? values[a] > values[b] : values[a] < values[b];
+    });
+    
+    return order;
+}
+
+void Mesh::simplify(const std::vector<int>& targets, std::vector<Mesh>& lods)
+{
+    // clustering may only run down to the largest target
+    int maxTarget = 0;
+    for (size_t i = 0; i < targets.size(); i++) maxTarget = std::max(maxTarget, targets[i]);
+    prepareSimplification(maxTarget, true);
+    
+    // 4
+    lods.resize(targets.size());
+    std::vector<int> order = thresholdOrder(targets, true);
+    
+    for (int i = 0; i < (int)order.size(); i++) {
+        collapseEdges(targets[order[i]], INFINITY);
+        copyLod(lods[order[i]]);
+    }
+    
+    // clean up
+    finishSimplification();
+}
+
+void Mesh::simplifyToErrors(const std::vector<double>& maxErrors, std::vector<Mesh>& lods)
+{
+    // clustering ignores error thresholds, so it is skipped
+    prepareSimplification(0, false);
+    
+    // 4
+    lods.resize(maxErrors.size());
+    std::vector<int> order = thresholdOrder(maxErrors, false);
+    
+    for (int i = 0; i < (int)order.size(); i++) {
+        collapseEdges(0, maxErrors[order[i]]);
+        copyLod(lods[order[i]]);
+    }
+    
+    // clean up
+    finishSimplification();
+}
+
+bool Mesh::claimNeighborhood(EdgeHandle e, int stamp, std::vector<int>& stamps) const
+{
+    HalfEdgeHandle eHe = he(e);
+    VertexHandle ends[2] = {vertex(eHe), vertex(flip(eHe))};
+    
+    // check
+    for (int i = 0; i < 2; i++) {
+        if (stamps[ends[i].index] == stamp) return false;
         
-        } else if (e->remove) {
-            heap.pop();
+        HalfEdgeHandle vHe = he(ends[i]);
+        HalfEdgeHandle h = vHe;
+        do {
+            if (stamps[vertex(flip(h)).index] == stamp) return false;
+            
+            h = next(flip(h));
+        } while (h != vHe);
+    }
+    
+    // stamp
+    for (int i = 0; i < 2; i++) {
+        stamps[ends[i].index] = stamp;
         
+        HalfEdgeHandle vHe = he(ends[i]);
+        HalfEdgeHandle h = vHe;
+        do {
+            stamps[vertex(flip(h)).index] = stamp;
+            
+            h = next(flip(h));
+        } while (h != vHe);
+    }
+    
+    return true;
+}
+
+void Mesh::moveFacesOff(EdgeHandle e)
+{
+    HalfEdgeHandle eHe = he(e);
+    HalfEdgeHandle sides[2] = {eHe, flip(eHe)};
+    for (int i = 0; i < 2; i++) {
+        HalfEdgeHandle h = sides[i];
+        if (halfEdges[h.index].onBoundary) {
+            // the edge leaves its hole, the halfedge after it stays
+            if (he(face(h)) == h) he(face(h)) = next(h);
+            
         } else {
-            (*handles[e->index]).cost = INFINITY;
-            heap.update(handles[e->index]);
+            // the triangle is removed and one of its sides takes the place of the
+            // other in the neighboring face, as in Edge::collapse
+            HalfEdgeHandle removed = i == 0 ? flip(next(next(h))) : flip(next(h));
+            HalfEdgeHandle kept = i == 0 ? next(h) : next(next(h));
+            if (he(face(removed)) == removed) he(face(removed)) = kept;
+        }
+    }
+}
+
+void Mesh::rejectEdge(EdgeHandle e)
+{
+    if (heap.contains(e)) heap.remove(e);
+    
+    HalfEdgeHandle eHe = he(e);
+    rejectedAround[vertex(eHe).index] = 1;
+    rejectedAround[vertex(flip(eHe)).index] = 1;
+}
+
+void Mesh::collectRejected(VertexHandle v, std::vector<EdgeHandle>& rejected)
+{
+    HalfEdgeHandle vHe = he(v);
+    HalfEdgeHandle h = vHe;
+    do {
+        // both ends of a rejected edge are flagged, so unflagged neighbors can be
+        // skipped. Every rejected edge around w is collected, which clears its flag
+        HalfEdgeHandle wHe = flip(h);
+        char& flag = rejectedAround[vertex(wHe).index];
+        if (flag) {
+            HalfEdgeHandle g = wHe;
+            do {
+                EdgeHandle e = edge(g);
+                if (!edges[e.index].remove && !heap.contains(e)) rejected.push_back(e);
+                
+                g = next(flip(g));
+            } while (g != wHe);
+            flag = 0;
+        }
+        
+        h = next(flip(h));
+    } while (h != vHe);
+}
+
+// candidates each round may hold, as a multiple of the previous batch size
+#define PARALLEL_CANDIDATE_FACTOR 2
+
+// orders edges by collapse cost
+class CostLess {
+public:
+    CostLess(const std::vector<Edge>& edges_): edges(edges_) {}
+    
+    bool operator()(EdgeHandle a, EdgeHandle b) const
+    {
+        return edges[a.index].cost < edges[b.index].cost;
+    }
+    
+    const std::vector<Edge>& edges;
+};
+
+void Mesh::simplifyParallel(int target, double tolerance)
+{
+    prepareSimplification(target, true);
+    
+    // 4
+    std::vector<int> stamps(vertices.size(), -1);
+    std::vector<int> touched(vertices.size(), -1);
+    std::vector<int> dirtyStamps(edges.size(), -1);
+    std::vector<char> held(edges.size(), 0);
+    std::vector<VertexStamps> slotStamps(resolveThreadCount(threads));
+    std::vector<EdgeHandle> candidates;
+    std::vector<char> valid;
+    std::vector<EdgeHandle> waiting;
+    std::vector<EdgeHandle> selectable;
+    std::vector<EdgeHandle> batch;
+    std::vector<EdgeHandle> sides;
+    std::vector<VertexHandle> merged;
+    std::vector<int> removedFaces;
+    std::vector<EdgeHandle> dirty;
+    CostLess cheaper(edges);
+    
+    Clock::time_point start = Clock::now();
+    int& nF = stats.faces;
+    int lastBatch = 0;
+    for (int round = 0; nF > target && (!heap.empty() || !waiting.empty() || !candidates.empty()); round++) {
+        // edges that lost their claim wait outside the heap in cost order, and those
+        // whose neighborhood changed are validated again. The cheapest edges in the
+        // heap join them up to a small multiple of the previous batch, since larger
+        // rounds mostly fail to claim
+        int k = std::max(1, (int)(tolerance*(heap.size() + waiting.size() + candidates.size())));
+        if (lastBatch > 0) k = std::min(k, PARALLEL_CANDIDATE_FACTOR*lastBatch);
+        
+        int rechecked = (int)candidates.size();
+        while ((int)(waiting.size() + candidates.size()) < k && !heap.empty()) {
+            EdgeHandle e = heap.top();
+            heap.pop();
+            
+            if (!edges[e.index].remove) {
+                candidates.push_back(e);
+                held[e.index] = 1;
+                
+            } else {
+                stats.stalePops++;
+            }
+        }
+        std::inplace_merge(candidates.begin(), candidates.begin() + rechecked, candidates.end(), cheaper);
+        
+        // check validity against the mesh as it was at the start of the round, in
+        // one contiguous range per thread with its own stamps
+        int n = (int)candidates.size();
+        int slots = std::min((int)slotStamps.size(), std::max(1, n / PARALLEL_GRAIN_SIZE));
+        valid.resize(n);
+        parallelFor(0, slots, slots, [&](int t) {
+            int last = (int)((long long)n * (t + 1) / slots);
+            for (int i = (int)((long long)n * t / slots); i < last; i++) {
+                valid[i] = edges[candidates[i].index].validCollapse(*this, slotStamps[t]);
+            }
+        }, 1);
+        
+        // valid candidates join the waiting edges in cost order
+        int nValid = 0;
+        for (int i = 0; i < n; i++) {
+            if (valid[i]) {
+                candidates[nValid++] = candidates[i];
+                
+            } else {
+                held[candidates[i].index] = 0;
+                rejectEdge(candidates[i]);
+                stats.rejectedCollapses++;
+            }
+        }
+        selectable.resize(waiting.size() + nValid);
+        std::merge(waiting.begin(), waiting.end(), candidates.begin(), candidates.begin() + nValid,
+                   selectable.begin(), cheaper);
+        
+        // greedily select an independent set of collapses, cheapest first.
+        // Collapses with disjoint vertex neighborhoods only share the faces of
+        // holes they touch, whose halfedge a collapse moves off the halfedges it
+        // removes. That is done here for the whole batch, so the collapses below
+        // only read hole faces and can run concurrently. The rest keep waiting
+        int maxCollapses = (nF - target + 1) / 2;
+        batch.clear();
+        sides.clear();
+        waiting.clear();
+        for (int i = 0; i < (int)selectable.size(); i++) {
+            Edge& e = edges[selectable[i].index];
+            
+            if ((int)batch.size() < maxCollapses && claimNeighborhood(selectable[i], round, stamps)) {
+                HalfEdgeHandle eHe = he(selectable[i]);
+                sides.push_back(edge(next(eHe)));
+                sides.push_back(edge(next(next(eHe))));
+                sides.push_back(edge(next(flip(eHe))));
+                sides.push_back(edge(next(next(flip(eHe)))));
+                
+                moveFacesOff(selectable[i]);
+                batch.push_back(selectable[i]);
+                held[e.index] = 0;
+                stats.lastError = e.cost;
+                stats.maxError = std::max(stats.maxError, e.cost);
+            
+            } else {
+                waiting.push_back(selectable[i]);
+            }
+        }
+        
+        // record collapses in batch order, which is a valid sequential order
+        // since the collapses are independent
+        if (recordCollapses) {
+            for (int i = 0; i < (int)batch.size(); i++) {
+                progressiveMesh.recordCollapse(*this, batch[i], edges[batch[i].index].position);
+            }
+        }
+        
+        // collapse edges
+        merged.resize(batch.size());
+        removedFaces.resize(batch.size());
+        parallelFor(0, (int)batch.size(), threads, [&](int i) {
+            Edge& e = edges[batch[i].index];
+            HalfEdgeHandle eHe = he(batch[i]);
+            Vertex& v1 = vertices[vertex(eHe).index];
+            const Vertex& v2 = vertices[vertex(flip(eHe)).index];
+            
+            // update vertex position and quadric
+            v1.position = e.position;
+            v1.quadric += v2.quadric;
+            
+            rejectedAround[v1.index] |= rejectedAround[v2.index];
+            removedFaces[i] = e.collapse(*this);
+            merged[i] = VertexHandle(v1.index);
+        });
+        for (int i = 0; i < (int)batch.size(); i++) nF -= removedFaces[i];
+        stats.collapses += (int)batch.size();
+        stats.rounds++;
+        lastBatch = (int)batch.size();
+        
+        // drop removed edges now, while they sit deep in the heap, instead of
+        // popping them from the top later
+        for (int i = 0; i < (int)sides.size(); i++) {
+            if (edges[sides[i].index].remove && heap.contains(sides[i])) heap.remove(sides[i]);
+        }
+        
+        // update edge collapse cost and re-queue rejected edges whose neighborhood
+        // changed, along with waiting edges whose cost changed. Neighborhoods of
+        // different merged vertices can overlap in the second ring, so duplicates
+        // are dropped before costs are computed in parallel
+        dirty.clear();
+        for (int i = 0; i < (int)merged.size(); i++) {
+            touched[merged[i].index] = round;
             
-            const Edge& topE = heap.top();
-            EdgeIter e2 = edges.begin() + topE.index;
+            HalfEdgeHandle vHe = he(merged[i]);
+            HalfEdgeHandle h = vHe;
+            do {
+                dirty.push_back(edge(h));
+                touched[vertex(flip(h)).index] = round;
+                
+                h = next(flip(h));
+            } while (h != vHe);
             
-            if (e == e2) break;
+            collectRejected(merged[i], dirty);
+        }
+        
+        int nDirty = 0;
+        for (int i = 0; i < (int)dirty.size(); i++) {
+            if (dirtyStamps[dirty[i].index] != round) {
+                dirtyStamps[dirty[i].index] = round;
+                dirty[nDirty++] = dirty[i];
+            }
+        }
+        dirty.resize(nDirty);
+        
+        parallelFor(0, (int)dirty.size(), threads, [&](int i) {
+            edges[dirty[i].index].computeCollapseCost(*this);
+        });
+        
+        for (int i = 0; i < (int)dirty.size(); i++) {
+            held[dirty[i].index] = 0;
+            heap.push(dirty[i], edges[dirty[i].index].cost, edges[dirty[i].index].version);
         }
+        stats.costRecomputes += (int)dirty.size();
+        stats.heapUpdates += (int)dirty.size();
+        
+        // waiting edges stay valid unless a collapse changed the one ring of an end,
+        // which leaves the end in the closed one ring of a merged vertex. Those are
+        // validated again next round, removed ones are dropped and those with a new
+        // cost are back in the heap
+        candidates.clear();
+        int nWaiting = 0;
+        for (int i = 0; i < (int)waiting.size(); i++) {
+            EdgeHandle e = waiting[i];
+            if (!held[e.index]) continue;
+            
+            HalfEdgeHandle eHe = he(e);
+            if (edges[e.index].remove) {
+                held[e.index] = 0;
+                
+            } else if (touched[vertex(eHe).index] == round || touched[vertex(flip(eHe)).index] == round) {
+                candidates.push_back(e);
+                
+            } else {
+                waiting[nWaiting++] = e;
+            }
+        }
+        waiting.resize(nWaiting);
+        
+        if (progress) reportProgress();
     }
+    stats.collapseTime = secondsSince(start);
     
     // clean up
-    resetLists();
-    heap.clear();
-    handles.clear();
+    finishSimplification();
 }
 
 void Mesh::normalize()
@@ -222,19 +987,19 @@ void Mesh::normalize()
     // compute center of mass
     Eigen::Vector3d cm = Eigen::Vector3d::Zero();
     for (VertexCIter v = vertices.begin(); v != vertices.end(); v++) {
-        cm += v->position;
+        cm += v->position.cast<double>();
     }
     cm /= (double)vertices.size();
     
     // translate to origin and determine radius
     double rMax = 0;
     for (VertexIter v = vertices.begin(); v != vertices.end(); v++) {
-        v->position -= cm;
-        rMax = std::max(rMax, v->position.norm());
+        v->position -= cm.cast<Scalar>();
+        rMax = std::max(rMax, (double)v->position.norm());
     }
     
     // rescale to unit sphere
     for (VertexIter v = vertices.begin(); v != vertices.end(); v++) {
-        v->position /= rMax;
+        v->position /= (Scalar)rMax;
     }
 }
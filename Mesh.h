@@ -6,14 +6,56 @@
 #include "Edge.h"
 #include "Face.h"
 #include "HalfEdge.h"
+#include "EdgeHeap.h"
+#include "Validation.h"
+#include "ProgressiveMesh.h"
+#include "SimplifyStats.h"
+#include <chrono>
+#include <functional>
+
+// elements, connectivity and free slots of a mesh, taken without the heap
+class MeshSnapshot {
+public:
+    std::vector<HalfEdge> halfEdges;
+    std::vector<Vertex> vertices;
+    std::vector<Vector3s> uvs;
+    std::vector<Vector3s> normals;
+    std::vector<Edge> edges;
+    std::vector<Face> faces;
+    std::vector<HalfEdgeHandle> boundaries;
+    std::vector<HalfEdgeHandle> heNext;
+    std::vector<HalfEdgeHandle> heFlip;
+    std::vector<VertexHandle> heVertex;
+    std::vector<EdgeHandle> heEdge;
+    std::vector<FaceHandle> heFace;
+    std::vector<HalfEdgeHandle> vertexHe;
+    std::vector<HalfEdgeHandle> edgeHe;
+    std::vector<HalfEdgeHandle> faceHe;
+    std::vector<HalfEdgeHandle> freeHalfEdges;
+    std::vector<VertexHandle> freeVertices;
+    std::vector<EdgeHandle> freeEdges;
+    std::vector<FaceHandle> freeFaces;
+};
 
 class Mesh {
 public:
     // default constructor
     Mesh();
     
-    // copy constructor
-    Mesh(const Mesh& mesh);
+    // copy constructor. Elements refer to each other by index, so the copied
+    // arrays are independent of the original without relocating any links
+    Mesh(const Mesh& mesh) = default;
+    
+    // copy assignment
+    Mesh& operator=(const Mesh& mesh) = default;
+    
+    // saves the current elements and connectivity, along with the free slots of
+    // removed elements kept by keepRemoved
+    void snapshot(MeshSnapshot& snapshot) const;
+    
+    // returns the mesh to a saved state. Arrays are copied in bulk and reuse their
+    // capacity, so restoring does not reparse or rebuild connectivity
+    void restore(const MeshSnapshot& snapshot);
         
     // read mesh from file
     bool read(const std::string& fileName);
@@ -24,14 +66,125 @@ public:
     // simplifies mesh
     void simplify(int target);
     
+    // simplifies mesh through all face count targets in a single pass, lods[i] receives
+    // a compacted copy of the mesh taken when targets[i] is reached. The mesh ends up
+    // simplified to the smallest target
+    void simplify(const std::vector<int>& targets, std::vector<Mesh>& lods);
+    
+    // same as above, but lods[i] is taken before the first collapse whose quadric
+    // error exceeds maxErrors[i]
+    void simplifyToErrors(const std::vector<double>& maxErrors, std::vector<Mesh>& lods);
+    
+    // simplifies mesh by collapsing batches of edges with disjoint neighborhoods in
+    // parallel. Each round considers at most the cheapest tolerance * |E| edges, and
+    // at most a small multiple of the previous batch, so larger tolerances trade
+    // collapse order accuracy for fewer, larger rounds
+    void simplifyParallel(int target, double tolerance = 0.05);
+    
+    // next halfedge around the current face
+    HalfEdgeHandle next(HalfEdgeHandle h) const { return heNext[h.index]; }
+    HalfEdgeHandle& next(HalfEdgeHandle h) { return heNext[h.index]; }
+    
+    // other halfedge associated with this edge
+    HalfEdgeHandle flip(HalfEdgeHandle h) const { return heFlip[h.index]; }
+    HalfEdgeHandle& flip(HalfEdgeHandle h) { return heFlip[h.index]; }
+    
+    // vertex at the tail of the halfedge
+    VertexHandle vertex(HalfEdgeHandle h) const { return heVertex[h.index]; }
+    VertexHandle& vertex(HalfEdgeHandle h) { return heVertex[h.index]; }
+    
+    // edge associated with this halfedge
+    EdgeHandle edge(HalfEdgeHandle h) const { return heEdge[h.index]; }
+    EdgeHandle& edge(HalfEdgeHandle h) { return heEdge[h.index]; }
+    
+    // face associated with this halfedge
+    FaceHandle face(HalfEdgeHandle h) const { return heFace[h.index]; }
+    FaceHandle& face(HalfEdgeHandle h) { return heFace[h.index]; }
+    
+    // outgoing halfedge of vertex, invalid if vertex is isolated
+    HalfEdgeHandle he(VertexHandle v) const { return vertexHe[v.index]; }
+    HalfEdgeHandle& he(VertexHandle v) { return vertexHe[v.index]; }
+    
+    // one of the two halfedges associated with edge
+    HalfEdgeHandle he(EdgeHandle e) const { return edgeHe[e.index]; }
+    HalfEdgeHandle& he(EdgeHandle e) { return edgeHe[e.index]; }
+    
+    // one of the halfedges associated with face
+    HalfEdgeHandle he(FaceHandle f) const { return faceHe[f.index]; }
+    HalfEdgeHandle& he(FaceHandle f) { return faceHe[f.index]; }
+    
+    // creates elements with unset connectivity, reusing free slots first
+    HalfEdgeHandle newHalfEdge();
+    VertexHandle newVertex();
+    EdgeHandle newEdge();
+    FaceHandle newFace();
+    
+    // number of threads used for parallel stages, 0 uses all hardware threads
+    int threads;
+    
+    // checks run when a mesh is read, and the problems they found
+    ValidationLevel validationLevel;
+    ValidationReport validationReport;
+    
+    // when set, simplification records its collapses in progressiveMesh so that
+    // any face count down to the target can be extracted later. It is cleared
+    // if the mesh has faces that are not triangles
+    bool recordCollapses;
+    ProgressiveMesh progressiveMesh;
+    
+    // when set, simplification leaves removed elements in their slots marked for
+    // removal and lists the slots for reuse instead of compacting the mesh
+    bool keepRemoved;
+    
+    // when positive and the mesh has more than clusterFactor * target faces,
+    // simplification first merges vertices sharing a uniform grid cell, down to
+    // about clusterFactor * target faces, before the heap driven collapses
+    double clusterFactor;
+    
+    // weight of the constraint planes that hold boundary edges in place. Boundary
+    // vertices are only collapsed when it is positive
+    double boundaryWeight;
+    
+    // counters and timings of the latest simplification
+    SimplifyStats stats;
+    
+    // when set, called with the current statistics while edges are collapsed,
+    // at most once every progressInterval seconds
+    std::function<void(const SimplifyStats&)> progress;
+    double progressInterval;
+    
+    // compacts elements marked for removal away, preserving element order
+    void resetLists();
+    
     // member variables
     std::vector<HalfEdge> halfEdges;
     std::vector<Vertex> vertices;
-    std::vector<Eigen::Vector3d> uvs;
-    std::vector<Eigen::Vector3d> normals;
+    std::vector<Vector3s> uvs;
+    std::vector<Vector3s> normals;
     std::vector<Edge> edges;
     std::vector<Face> faces;
-    std::vector<HalfEdgeIter> boundaries;
+    std::vector<HalfEdgeHandle> boundaries;
+    
+    // halfedge connectivity, indexed by halfedge
+    std::vector<HalfEdgeHandle> heNext;
+    std::vector<HalfEdgeHandle> heFlip;
+    std::vector<VertexHandle> heVertex;
+    std::vector<EdgeHandle> heEdge;
+    std::vector<FaceHandle> heFace;
+    
+    // element to halfedge connectivity, indexed by vertex, edge and face
+    std::vector<HalfEdgeHandle> vertexHe;
+    std::vector<HalfEdgeHandle> edgeHe;
+    std::vector<HalfEdgeHandle> faceHe;
+    
+    // slots of removed elements, empty after compaction
+    std::vector<HalfEdgeHandle> freeHalfEdges;
+    std::vector<VertexHandle> freeVertices;
+    std::vector<EdgeHandle> freeEdges;
+    std::vector<FaceHandle> freeFaces;
+    
+    // checks if any removed slots are kept
+    bool hasRemoved() const;
 
 private:
     // center mesh about origin and rescale to unit radius
@@ -43,12 +196,57 @@ private:
     // computes edge collapse cost
     void computeEdgeCollapseCost();
 
-    // removes edges marked for deletion
-    void resetLists();
+    // stamps the closed one rings of both edge vertices if none of them carry
+    // the stamp yet, returns false without stamping otherwise
+    bool claimNeighborhood(EdgeHandle e, int stamp, std::vector<int>& stamps) const;
+    
+    // points faces whose halfedge collapsing e would remove at a halfedge that
+    // stays in the face, so that the collapse leaves them untouched
+    void moveFacesOff(EdgeHandle e);
+    
+    // takes a rejected edge out of the heap until a collapse changes its neighborhood
+    void rejectEdge(EdgeHandle e);
+    
+    // appends rejected edges around the neighbors of v, whose validity depends on
+    // the neighborhood that a collapse into v changed
+    void collectRejected(VertexHandle v, std::vector<EdgeHandle>& rejected);
+
+    // merges vertices within grid cells by collapsing the edges between them, in
+    // linear time, until about clusterFactor * target faces remain
+    void clusterVertices(int target);
+    
+    // computes quadrics, clusters vertices towards target if cluster is set, computes
+    // collapse costs and the heap
+    void prepareSimplification(int target, bool cluster);
+    
+    // collapses edges until the face count reaches target or the cheapest collapse
+    // costs more than maxError
+    void collapseEdges(int target, double maxError);
+    
+    // copies elements, connectivity and settings into lod, without the heap or the
+    // progressive mesh record, and compacts the copy
+    void copyLod(Mesh& lod);
+    
+    // calls progress if progressInterval has passed since the last call
+    void reportProgress();
+    
+    // lists slots of removed elements
+    void collectRemoved();
+    
+    // compacts or collects removed elements and clears the heap
+    void finishSimplification();
     
     // heap 
-    boost::heap::fibonacci_heap<Edge> heap;
-    std::vector<boost::heap::fibonacci_heap<Edge>::handle_type> handles;
+    EdgeHeap heap;
+    
+    // one ring stamps for validating collapses outside of parallel batches
+    VertexStamps ringStamps;
+    
+    // per vertex flag for rejected edges around the vertex that are not in the heap
+    std::vector<char> rejectedAround;
+    
+    // time progress was last reported
+    std::chrono::steady_clock::time_point lastProgress;
 };
 
 #endif
@@ -0,0 +1,157 @@
+#include "MeshBatch.h"
+#include "Mesh.h"
+#include "Parallel.h"
+#include "Timer.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sys/stat.h>
+
+BatchJob::BatchJob(const std::string& inFileName, const std::string& outFileName, double ratio):
+inFileName(inFileName),
+outFileName(outFileName),
+ratio(ratio),
+validationLevel(VALIDATION_FAST),
+clusterFactor(0),
+tolerance(0),
+success(false),
+faces(0),
+finalFaces(0),
+estimatedMemory(0),
+readTime(0),
+simplifyTime(0),
+writeTime(0)
+{
+    
+}
+
+void MeshBatch::runJob(BatchJob& job, int threads)
+{
+    Mesh mesh;
+    mesh.threads = threads;
+    mesh.validationLevel = job.validationLevel;
+    mesh.clusterFactor = job.clusterFactor;
+    
+    Clock::time_point start = Clock::now();
+    if (!mesh.read(job.inFileName)) {
+        job.error = "could not read " + job.inFileName;
+        return;
+    }
+    job.readTime = secondsSince(start);
+    
+    job.faces = (int)mesh.faces.size();
+    start = Clock::now();
+    int target = (int)(job.ratio*job.faces);
+    if (job.tolerance > 0) mesh.simplifyParallel(target, job.tolerance);
+    else mesh.simplify(target);
+    job.simplifyTime = secondsSince(start);
+    job.finalFaces = (int)mesh.faces.size();
+    
+    start = Clock::now();
+    if (!mesh.write(job.outFileName)) {
+        job.error = "could not write " + job.outFileName;
+        return;
+    }
+    job.writeTime = secondsSince(start);
+    
+    job.success = true;
+}
+
+// per worker queue of job indices. The owner pops from the back and thieves take
+// from the front, so both ends are contended only when one job is left
+class JobQueue {
+public:
+    bool pop(int& job, bool steal) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (jobs.empty()) return false;
+        
+        if (steal) {
+            job = jobs.front();
+            jobs.pop_front();
+            
+        } else {
+            job = jobs.back();
+            jobs.pop_back();
+        }
+        
+        return true;
+    }
+    
+    std::deque<int> jobs;
+    std::mutex mutex;
+};
+
+void MeshBatch::run(std::vector<BatchJob>& jobs, int workers, size_t memoryBudget, int threadsPerJob)
+{
+    workers = std::max(1, std::min(resolveThreadCount(workers), (int)jobs.size()));
+    
+    // estimate memory from file sizes
+    for (size_t i = 0; i < jobs.size(); i++) {
+        struct stat st;
+        jobs[i].estimatedMemory = stat(jobs[i].inFileName.c_str(), &st) == 0 ?
+                                  (size_t)st.st_size*BATCH_MEMORY_PER_FILE_BYTE : 0;
+    }
+    
+    // deal jobs round robin so every worker starts with a mix of sizes
+    std::vector<JobQueue> queues(workers);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        queues[i % workers].jobs.push_back((int)i);
+    }
+    
+    // memory admission
+    std::mutex memoryMutex;
+    std::condition_variable memoryReleased;
+    size_t memoryInUse = 0;
+    int running = 0;
+    
+    std::vector<std::thread> pool;
+    for (int w = 0; w < workers; w++) {
+        pool.push_back(std::thread([&, w]() {
+            int job;
+            while (true) {
+                // take own work first, then steal
+                bool found = queues[w].pop(job, false);
+                for (int k = 1; k < workers && !found; k++) {
+                    found = queues[(w + k) % workers].pop(job, true);
+                }
+                if (!found) break;
+                
+                size_t memory = jobs[job].estimatedMemory;
+                if (memoryBudget > 0) {
+                    std::unique_lock<std::mutex> lock(memoryMutex);
+                    memoryReleased.wait(lock, [&]() {
+                        return running == 0 || memoryInUse + memory <= memoryBudget;
+                    });
+                    memoryInUse += memory;
+                    running++;
+                }
+                
+                // a failing job is reported on its own and the worker moves on
+                try {
+                    runJob(jobs[job], threadsPerJob);
+                    
+                } catch (const std::exception& e) {
+                    jobs[job].success = false;
+                    jobs[job].error = std::string("aborted: ") + e.what();
+                    
+                } catch (...) {
+                    jobs[job].success = false;
+                    jobs[job].error = "aborted by an unknown exception";
+                }
+                
+                if (memoryBudget > 0) {
+                    {
+                        std::lock_guard<std::mutex> lock(memoryMutex);
+                        memoryInUse -= memory;
+                        running--;
+                    }
+                    memoryReleased.notify_all();
+                }
+            }
+        }));
+    }
+    
+    for (size_t w = 0; w < pool.size(); w++) {
+        pool[w].join();
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef MESH_BATCH_H
+#define MESH_BATCH_H
+
+#include "Types.h"
+#include "Validation.h"
+
+// estimated peak bytes in memory per byte of input file while a mesh is read and simplified
+#define BATCH_MEMORY_PER_FILE_BYTE 16
+
+class BatchJob {
+public:
+    // constructor
+    BatchJob(const std::string& inFileName, const std::string& outFileName, double ratio);
+    
+    // input and output files, the output format is chosen by extension
+    std::string inFileName;
+    std::string outFileName;
+    
+    // target face count as a fraction of the input faces
+    double ratio;
+    
+    // checks run when the input is read, and the clustering factor and parallel
+    // collapse tolerance passed to Mesh. A tolerance of 0 collapses serially
+    ValidationLevel validationLevel;
+    double clusterFactor;
+    double tolerance;
+    
+    // filled in when the job has run. A job that throws fails with the exception
+    // message as its error, without stopping the other jobs
+    bool success;
+    std::string error;
+    int faces;
+    int finalFaces;
+    size_t estimatedMemory;
+    double readTime;
+    double simplifyTime;
+    double writeTime;
+};
+
+class MeshBatch {
+public:
+    // reads, simplifies and writes every job on a pool of workers, 0 uses all hardware
+    // threads. Idle workers steal jobs from busy ones, and a job only starts when the
+    // estimated memory of all running jobs stays within memoryBudget bytes (0 for no
+    // limit). A job larger than the budget runs alone
+    static void run(std::vector<BatchJob>& jobs, int workers = 0, size_t memoryBudget = 0,
+                    int threadsPerJob = 1);
+    
+private:
+    // runs a single job
+    static void runJob(BatchJob& job, int threads);
+};
+
+#endif
@@ -1,98 +1,54 @@
 #include "MeshIO.h"
 #include "Mesh.h"
-#include <set>
-#include <map>
+#include "Parallel.h"
+#include <string.h>
+#include <algorithm>
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-class Index {
-public:
-    Index() {}
-    
-    Index(int v, int vt, int vn): position(v), uv(vt), normal(vn) {}
-    
-    bool operator<(const Index& i) const {
-        if (position < i.position) return true;
-        if (position > i.position) return false;
-        if (uv < i.uv) return true;
-        if (uv > i.uv) return false;
-        if (normal < i.normal) return true;
-        if (normal > i.normal) return false;
-        
-        return false;
-    }
-    
-    int position;
-    int uv;
-    int normal;
-};
-
-class MeshData {
-public:
-    std::vector<Eigen::Vector3d> positions;
-    std::vector<Eigen::Vector3d> uvs;
-    std::vector<Eigen::Vector3d> normals;
-    std::vector<std::vector<Index>> indices;
-};
-
-Index parseFaceIndex(const std::string& token)
-{
-    std::stringstream in(token);
-    std::string indexString;
-    int indices[3] = {-1, -1, -1};
-    
-    int i = 0;
-    while(getline(in,indexString,'/')) {
-        if (indexString != "\\") {
-            std::stringstream ss(indexString);
-            ss >> indices[i++];
-        }
-    }
-    
-    // decrement since indices in OBJ files are 1-based
-    return Index(indices[0]-1,
-                 indices[1]-1,
-                 indices[2]-1);
-}
-
-std::string stringRep(const Eigen::Vector3d& v)
+void MeshIO::preallocateMeshElements(const MeshData& data, size_t nE, Mesh& mesh)
 {
-    return std::to_string(v.x()) + " " + std::to_string(v.y()) + " " + std::to_string(v.z());
-}
-
-void MeshIO::preallocateMeshElements(const MeshData& data, Mesh& mesh)
-{
-    // count the number of edges
-    std::set<std::pair<int,int>> edges;
-    for (std::vector<std::vector<Index>>::const_iterator f  = data.indices.begin();
-                                                         f != data.indices.end();
-                                                         f ++) {
-        for (unsigned int I = 0; I < f->size(); I++) {
-            int J = (I+1) % f->size();
-            int i = (*f)[I].position;
-            int j = (*f)[J].position;
-            
-            if (i > j) std::swap(i, j);
-            
-            edges.insert(std::pair<int,int>(i, j));
-        }
-    }
-    
     size_t nV = data.positions.size();
-    size_t nE = edges.size();
-    size_t nF = data.indices.size();
+    size_t nF = data.nFaces();
     size_t nHE = 2*nE;
     size_t chi = nV - nE + nF;
     int nB = std::max(0, 2 - (int)chi); // conservative approximation of number of boundary cycles
     
     mesh.halfEdges.clear();
     mesh.vertices.clear();
+    mesh.uvs.clear();
+    mesh.normals.clear();
     mesh.edges.clear();
     mesh.faces.clear();
     mesh.boundaries.clear();
+    mesh.heNext.clear();
+    mesh.heFlip.clear();
+    mesh.heVertex.clear();
+    mesh.heEdge.clear();
+    mesh.heFace.clear();
+    mesh.vertexHe.clear();
+    mesh.edgeHe.clear();
+    mesh.faceHe.clear();
+    mesh.freeHalfEdges.clear();
+    mesh.freeVertices.clear();
+    mesh.freeEdges.clear();
+    mesh.freeFaces.clear();
     
     mesh.halfEdges.reserve(nHE);
     mesh.vertices.reserve(nV);
     mesh.edges.reserve(nE);
     mesh.faces.reserve(nF + nB);
+    mesh.heNext.reserve(nHE);
+    mesh.heFlip.reserve(nHE);
+    mesh.heVertex.reserve(nHE);
+    mesh.heEdge.reserve(nHE);
+    mesh.heFace.reserve(nHE);
+    mesh.vertexHe.reserve(nV);
+    mesh.edgeHe.reserve(nE);
+    mesh.faceHe.reserve(nF + nB);
 }
 
 void MeshIO::indexElements(Mesh& mesh)
@@ -122,200 +78,400 @@ void MeshIO::indexElements(Mesh& mesh)
     }
 }
 
-void MeshIO::checkIsolatedVertices(const Mesh& mesh)
+void MeshIO::markBoundaryVertices(Mesh& mesh)
 {
-    for (VertexCIter v = mesh.vertices.begin(); v != mesh.vertices.end(); v++) {
-        if (v->isIsolated()) {
-            std::cerr << "Warning: vertex " << v->index
-                      << " is isolated (not contained in any face)."
-                      << std::endl;
-        }
-    }
+    parallelFor(0, (int)mesh.vertices.size(), mesh.threads, [&](int i) {
+        Vertex& v = mesh.vertices[i];
+        v.boundary = !v.isIsolated(mesh) && v.onBoundary(mesh);
+    });
 }
 
-void MeshIO::checkNonManifoldVertices(const Mesh& mesh)
+bool MeshIO::checkConnectivity(const Mesh& mesh, ValidationReport& report)
 {
-    std::unordered_map<std::string, int> vertexFaceMap;
+    const uint32_t nHE = (uint32_t)mesh.halfEdges.size();
+    const uint32_t nV = (uint32_t)mesh.vertices.size();
+    const uint32_t nE = (uint32_t)mesh.edges.size();
+    const uint32_t nF = (uint32_t)mesh.faces.size();
     
-    for (FaceCIter f = mesh.faces.begin(); f != mesh.faces.end(); f++) {
-        HalfEdgeCIter he = f->he;
+    // handles must be in range before any invariant can be evaluated
+    std::vector<char> invalid(nHE, false);
+    parallelFor(0, (int)nHE, mesh.threads, [&](int i) {
+        invalid[i] = mesh.heNext[i].index >= nHE || mesh.heFlip[i].index >= nHE ||
+                     mesh.heVertex[i].index >= nV || mesh.heEdge[i].index >= nE ||
+                     mesh.heFace[i].index >= nF;
+    });
+    
+    bool inRange = true;
+    for (uint32_t i = 0; i < nHE; i++) {
+        if (invalid[i]) inRange = false;
+    }
+    inRange = inRange && mesh.vertexHe.size() == nV && mesh.edgeHe.size() == nE && mesh.faceHe.size() == nF;
+    for (uint32_t i = 0; i < nV && inRange; i++) {
+        if (mesh.vertexHe[i].isValid() && mesh.vertexHe[i].index >= nHE) inRange = false;
+    }
+    for (uint32_t i = 0; i < nE && inRange; i++) {
+        if (mesh.edgeHe[i].index >= nHE) inRange = false;
+    }
+    for (uint32_t i = 0; i < nF && inRange; i++) {
+        if (mesh.faceHe[i].index >= nHE) inRange = false;
+    }
+    
+    if (!inRange) {
+        report.invalidHalfEdges = std::max(1, (int)std::count(invalid.begin(), invalid.end(), true));
+        return false;
+    }
+    
+    // halfedge invariants
+    parallelFor(0, (int)nHE, mesh.threads, [&](int i) {
+        HalfEdgeHandle h(i);
+        HalfEdgeHandle flip = mesh.flip(h);
+        EdgeHandle e = mesh.edge(h);
+        
+        invalid[i] = flip == h || mesh.flip(flip) != h ||
+                     mesh.vertex(flip) != mesh.vertex(mesh.next(h)) ||
+                     mesh.edge(flip) != e || (mesh.he(e) != h && mesh.he(e) != flip) ||
+                     mesh.face(mesh.next(h)) != mesh.face(h) ||
+                     mesh.halfEdges[i].onBoundary != mesh.halfEdges[mesh.he(mesh.face(h)).index].onBoundary;
+    });
+    report.invalidHalfEdges = (int)std::count(invalid.begin(), invalid.end(), true);
+    
+    // element to halfedge links
+    for (uint32_t i = 0; i < nV; i++) {
+        HalfEdgeHandle h = mesh.vertexHe[i];
+        if (h.isValid() && mesh.vertex(h).index != i) report.invalidVertices++;
+    }
+    
+    for (uint32_t i = 0; i < nE; i++) {
+        if (mesh.edge(mesh.edgeHe[i]).index != i) report.invalidEdges++;
+    }
+    
+    for (uint32_t i = 0; i < nF; i++) {
+        if (mesh.face(mesh.faceHe[i]).index != i) report.invalidFaces++;
+    }
+    
+    // degenerate faces, walks are bounded in case next cycles are broken
+    std::vector<char> degenerate(nF, false);
+    parallelFor(0, (int)nF, mesh.threads, [&](int i) {
+        HalfEdgeHandle fHe = mesh.faceHe[i];
+        HalfEdgeHandle h = fHe;
+        uint32_t n = 0;
         do {
-            vertexFaceMap[stringRep(he->vertex->position)] ++;
-            he = he->next;
+            if (mesh.vertex(h) == mesh.vertex(mesh.next(h)) || ++n > nHE) {
+                degenerate[i] = true;
+                break;
+            }
             
-        } while (he != f->he);
+            h = mesh.next(h);
+        } while (h != fHe);
+    });
+    
+    for (uint32_t i = 0; i < nF; i++) {
+        if (degenerate[i]) report.degenerateFaces.push_back((int)i);
+    }
+    
+    return true;
+}
+
+bool MeshIO::checkCycles(const Mesh& mesh)
+{
+    const uint32_t nHE = (uint32_t)mesh.heNext.size();
+    
+    std::vector<char> reached(nHE, false);
+    for (uint32_t i = 0; i < nHE; i++) {
+        uint32_t next = mesh.heNext[i].index;
+        uint32_t flip = mesh.heFlip[i].index;
+        if (reached[next] || flip == i || mesh.heFlip[flip].index != i) return false;
+        
+        reached[next] = true;
     }
     
-    for (VertexCIter v = mesh.vertices.begin(); v != mesh.vertices.end(); v++) {
-        int valence = 0;
-        HalfEdgeCIter he = v->he;
+    return true;
+}
+
+void MeshIO::checkVertices(const Mesh& mesh, ValidationReport& report)
+{
+    const uint32_t nHE = (uint32_t)mesh.halfEdges.size();
+    const uint32_t nV = (uint32_t)mesh.vertices.size();
+    
+    // walk each vertex's one ring and mark the outgoing halfedges it reaches. Every
+    // outgoing halfedge of v has v at its tail, so each mark is written by one thread
+    std::vector<char> reached(nHE, false);
+    parallelFor(0, (int)nV, mesh.threads, [&](int i) {
+        HalfEdgeHandle vHe = mesh.vertexHe[i];
+        if (!vHe.isValid()) return;
+        
+        HalfEdgeHandle h = vHe;
+        uint32_t n = 0;
         do {
-            valence ++;
-            he = he->flip->next;
+            reached[h.index] = true;
             
-        } while (he != v->he);
+            h = mesh.next(mesh.flip(h));
+        } while (h != vHe && ++n < nHE);
+    });
+    
+    // a vertex with outgoing halfedges outside its ring has more than one fan
+    std::vector<char> nonManifold(nV, false);
+    for (uint32_t i = 0; i < nHE; i++) {
+        if (!reached[i]) nonManifold[mesh.heVertex[i].index] = true;
+    }
+    
+    for (uint32_t i = 0; i < nV; i++) {
+        if (!mesh.vertexHe[i].isValid()) report.isolatedVertices.push_back((int)i);
+        else if (nonManifold[i]) report.nonManifoldVertices.push_back((int)i);
+    }
+}
+
+void MeshIO::validate(const Mesh& mesh, ValidationLevel level, ValidationReport& report)
+{
+    report.clear();
+    report.level = level;
+    
+    if (level == VALIDATION_OFF) return;
+    if (level == VALIDATION_FULL && !checkConnectivity(mesh, report)) return;
+    
+    checkVertices(mesh, report);
+}
+
+void MeshIO::validateAfterRead(Mesh& mesh)
+{
+    validate(mesh, mesh.validationLevel, mesh.validationReport);
+    
+    if (!mesh.validationReport.isValid()) {
+        std::cerr << "Warning: " << mesh.validationReport.summary() << std::endl;
+    }
+}
+
+class EdgeKey {
+public:
+    // (min, max) vertex pair
+    uint64_t key;
+    
+    // halfedge with these vertices
+    uint32_t he;
+};
+
+void radixSort(std::vector<EdgeKey>& keys)
+{
+    // least significant digit first, 8 bits per pass
+    std::vector<EdgeKey> buffer(keys.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < keys.size(); i++) {
+            counts[(keys[i].key >> shift) & 0xff]++;
+        }
         
-        if (vertexFaceMap[stringRep(v->position)] != valence) {
-            std::cerr << "Warning: vertex " << v->index
-                      << " is nonmanifold." << std::endl;
+        // skip passes where every key has the same digit
+        if (counts[(keys[0].key >> shift) & 0xff] == keys.size()) continue;
+        
+        size_t offset = 0;
+        for (int d = 0; d < 256; d++) {
+            size_t count = counts[d];
+            counts[d] = offset;
+            offset += count;
+        }
+        
+        for (size_t i = 0; i < keys.size(); i++) {
+            buffer[counts[(keys[i].key >> shift) & 0xff]++] = keys[i];
         }
+        keys.swap(buffer);
     }
 }
 
-extern std::vector<HalfEdge> isolated;
-
 bool MeshIO::buildMesh(const MeshData& data, Mesh& mesh)
 {
-    std::map<std::pair<int, int>, int> edgeCount;
-    std::map<std::pair<int, int>, HalfEdgeIter> existingHalfEdges;
-    std::map<int, VertexIter> indexToVertex;
-    std::map<HalfEdgeIter, bool> hasFlipEdge;
-    
-    preallocateMeshElements(data, mesh);
+    int nV = (int)data.positions.size();
+    int nUV = (int)data.uvs.size();
+    int nN = (int)data.normals.size();
+    int nF = data.nFaces();
     
-    // insert vertices into mesh and map vertex indices to vertex pointers
-    for (unsigned int i = 0; i < data.positions.size(); i++) {
-        VertexIter vertex = mesh.vertices.insert(mesh.vertices.end(), Vertex());
-        vertex->position = data.positions[i];
-        vertex->he = isolated.begin();
-        indexToVertex[i] = vertex;
+    // check for degenerate faces and invalid vertex, uv and normal indices. Uvs and
+    // normals are optional, -1 marks a missing one
+    bool validFaces = true;
+    for (int f = 0; f < nF; f++) {
+        int n = data.faceSize(f);
+        if (n < 3) {
+            std::cerr << "Error: face " << f << " is degenerate" << std::endl;
+            validFaces = false;
+        }
+        
+        const Index *face = data.face(f);
+        for (int i = 0; i < n; i++) {
+            if (face[i].position < 0 || face[i].position >= nV) {
+                std::cerr << "Error: face " << f << " has invalid vertex index" << std::endl;
+                validFaces = false;
+                break;
+            }
+            
+            if (face[i].uv < -1 || face[i].uv >= nUV) {
+                std::cerr << "Error: face " << f << " has invalid uv index" << std::endl;
+                validFaces = false;
+                break;
+            }
+            
+            if (face[i].normal < -1 || face[i].normal >= nN) {
+                std::cerr << "Error: face " << f << " has invalid normal index" << std::endl;
+                validFaces = false;
+                break;
+            }
+        }
     }
     
-    // insert uvs into mesh
-    for (unsigned int i = 0; i < data.uvs.size(); i++) {
-        VectorIter uv = mesh.uvs.insert(mesh.uvs.end(), Eigen::Vector3d());
-        *uv = data.uvs[i];
+    if (!validFaces) {
+        return false;
     }
     
-    // insert normals into mesh
-    for (unsigned int i = 0; i < data.normals.size(); i++) {
-        VectorIter normal = mesh.normals.insert(mesh.normals.end(), Eigen::Vector3d());
-        *normal = data.normals[i];
+    // sort interior halfedges by their (min, max) vertex pair so that halfedges
+    // of the same edge are adjacent. The sort is stable, so each run lists its
+    // halfedges in the order they are created below
+    uint32_t nInterior = (uint32_t)data.indices.size();
+    std::vector<EdgeKey> keys(nInterior);
+    for (int f = 0; f < nF; f++) {
+        const Index *face = data.face(f);
+        int n = data.faceSize(f);
+        uint32_t offset = data.faceOffsets[f];
+        
+        for (int i = 0; i < n; i++) {
+            uint64_t a = face[i].position;
+            uint64_t b = face[(i+1)%n].position;
+            if (a > b) std::swap(a, b);
+            
+            keys[offset + i].key = (a << 32) | b;
+            keys[offset + i].he = offset + i;
+        }
     }
-   
-    // insert faces into mesh
-    int faceIndex = 0;
-    bool degenerateFaces = false;
-    for (std::vector<std::vector<Index>>::const_iterator f  = data.indices.begin();
-                                                         f != data.indices.end();
-                                                         f ++) {
-        int n = (int)f->size();
+    if (nInterior > 0) radixSort(keys);
+    
+    // count edges and check for nonmanifold edges
+    size_t nE = 0;
+    for (uint32_t i = 0, j = 0; i < nInterior; i = j) {
+        while (j < nInterior && keys[j].key == keys[i].key) j++;
         
-        // check if face is degenerate
-        if (n < 3) {
-            std::cerr << "Error: face " << faceIndex << " is degenerate" << std::endl;
-            degenerateFaces = true;
-            continue;
+        if (j - i > 2) {
+            std::cerr << "Error: edge " << (keys[i].key >> 32) << ", " << (keys[i].key & 0xffffffff)
+                      << " is non manifold" << std::endl;
+            return false;
         }
         
+        nE++;
+    }
+    
+    preallocateMeshElements(data, nE, mesh);
+    
+    // insert vertices into mesh, vertex i has handle i
+    for (int i = 0; i < nV; i++) {
+        VertexHandle vertex = mesh.newVertex();
+        mesh.vertices[vertex.index].position = data.positions[i];
+    }
+    
+    // insert uvs and normals into mesh
+    mesh.uvs = data.uvs;
+    mesh.normals = data.normals;
+    
+    // insert faces into mesh, halfedges of face f are created at
+    // [faceOffsets[f], faceOffsets[f+1])
+    for (int f = 0; f < nF; f++) {
+        const Index *face = data.face(f);
+        int n = data.faceSize(f);
+        
         // create face
-        FaceIter newFace = mesh.faces.insert(mesh.faces.end(), Face());
+        FaceHandle newFace = mesh.newFace();
         
         // create a halfedge for each edge of the face
-        std::vector<HalfEdgeIter> halfEdges(n);
-        for (int i = 0; i < n; i++) {
-            halfEdges[i] = mesh.halfEdges.insert(mesh.halfEdges.end(), HalfEdge());
+        HalfEdgeHandle first = mesh.newHalfEdge();
+        for (int i = 1; i < n; i++) {
+            mesh.newHalfEdge();
         }
         
         // initialize the halfedges
         for (int i = 0; i < n; i++) {
-            // vertex indices
-            int a = (*f)[i].position;
-            int b = (*f)[(i+1)%n].position;
+            HalfEdgeHandle h(first.index + i);
+            HalfEdge& halfEdge = mesh.halfEdges[h.index];
+            VertexHandle a(face[i].position);
             
             // set halfedge attributes
-            halfEdges[i]->next = halfEdges[(i+1)%n];
-            halfEdges[i]->vertex = indexToVertex[a];
-            
-            int uv = (*f)[i].uv;
-            if (uv >= 0) halfEdges[i]->uv = data.uvs[uv];
-            else halfEdges[i]->uv.setZero();
+            mesh.next(h) = HalfEdgeHandle(first.index + (i+1)%n);
+            mesh.vertex(h) = a;
             
-            int normal = (*f)[i].normal;
-            if (normal >= 0) halfEdges[i]->normal = data.normals[normal];
-            else halfEdges[i]->normal.setZero();
+            int uv = face[i].uv;
+            if (uv >= 0) halfEdge.uv = data.uvs[uv];
+            else halfEdge.uv.setZero();
             
-            halfEdges[i]->onBoundary = false;
-            
-            // keep track of which halfedges have flip edges defined (for deteting boundaries)
-            hasFlipEdge[halfEdges[i]] = false;
+            int normal = face[i].normal;
+            if (normal >= 0) halfEdge.normal = data.normals[normal];
+            else halfEdge.normal.setZero();
             
             // point vertex a at the current halfedge
-            indexToVertex[a]->he = halfEdges[i];
+            mesh.he(a) = h;
             
             // point new face and halfedge to each other
-            halfEdges[i]->face = newFace;
-            newFace->he = halfEdges[i];
-            
-            // if an edge between a and b has been created in the past, it is the flip edge of the current halfedge
-            if (a > b) std::swap(a, b);
-            if (existingHalfEdges.find(std::pair<int, int>(a, b)) != existingHalfEdges.end()) {
-                halfEdges[i]->flip = existingHalfEdges[std::pair<int, int>(a, b)];
-                halfEdges[i]->flip->flip = halfEdges[i];
-                halfEdges[i]->edge = halfEdges[i]->flip->edge;
-                hasFlipEdge[halfEdges[i]] = true;
-                hasFlipEdge[halfEdges[i]->flip] = true;
-                
-            } else {
-                // create an edge and set its halfedge
-                halfEdges[i]->edge = mesh.edges.insert(mesh.edges.end(), Edge());
-                halfEdges[i]->edge->he = halfEdges[i];
-                edgeCount[std::pair<int, int>(a, b)] = 0;
-            }
-            
-            // record that halfedge has been created from a to b
-            existingHalfEdges[std::pair<int, int>(a, b)] = halfEdges[i];
+            mesh.face(h) = newFace;
+            mesh.he(newFace) = h;
+        }
+    }
+    
+    // pair up halfedges that share an edge
+    for (uint32_t i = 0; i + 1 < nInterior; i++) {
+        if (keys[i].key == keys[i+1].key) {
+            mesh.flip(HalfEdgeHandle(keys[i].he)) = HalfEdgeHandle(keys[i+1].he);
+            mesh.flip(HalfEdgeHandle(keys[i+1].he)) = HalfEdgeHandle(keys[i].he);
+            i++;
+        }
+    }
+    std::vector<EdgeKey>().swap(keys);
+    
+    // create an edge for each pair the first time one of its halfedges is seen,
+    // and keep track of which halfedges have flip edges defined (for deteting boundaries)
+    std::vector<char> hasFlipEdge(2*nE, false);
+    for (HalfEdgeHandle h(0); h.index < nInterior; h.index++) {
+        if (!mesh.edge(h).isValid()) {
+            EdgeHandle edge = mesh.newEdge();
+            mesh.edge(h) = edge;
+            mesh.he(edge) = h;
             
-            // check for nonmanifold edges
-            edgeCount[std::pair<int, int>(a, b)] ++;
-            if (edgeCount[std::pair<int, int>(a, b)] > 2) {
-                std::cerr << "Error: edge " << a << ", " << b << " is non manifold" << std::endl;
-                return false;
+            if (mesh.flip(h).isValid()) {
+                mesh.edge(mesh.flip(h)) = edge;
             }
         }
         
-        faceIndex++;
-    }
-    
-    if (degenerateFaces) {
-        return false;
+        hasFlipEdge[h.index] = mesh.flip(h).isValid();
     }
     
     // insert extra faces for boundary cycle
-    for (HalfEdgeIter currHe = mesh.halfEdges.begin(); currHe != mesh.halfEdges.end(); currHe++) {
+    for (HalfEdgeHandle currHe(0); currHe.index < nInterior; currHe.index++) {
         // if a halfedge with no flip edge is found, create a new face and link it the corresponding boundary cycle
-        if (!hasFlipEdge[currHe]) {
+        if (!hasFlipEdge[currHe.index]) {
             // create face
-            FaceIter newFace = mesh.faces.insert(mesh.faces.end(), Face());
+            FaceHandle newFace = mesh.newFace();
             
             // walk along boundary cycle
-            std::vector<HalfEdgeIter> boundaryCycle;
-            HalfEdgeIter he = currHe;
+            std::vector<HalfEdgeHandle> boundaryCycle;
+            HalfEdgeHandle he = currHe;
             do {
                 // create a new halfedge on the boundary face
-                HalfEdgeIter newHe = mesh.halfEdges.insert(mesh.halfEdges.end(), HalfEdge());
-                newHe->onBoundary = true;
+                HalfEdgeHandle newHe = mesh.newHalfEdge();
+                mesh.halfEdges[newHe.index].onBoundary = true;
                 
                 // link the current halfedge in the cycle to its new flip edge
-                he->flip = newHe;
+                mesh.flip(he) = newHe;
                 
                 // grab the next halfedge along the boundary by finding
                 // the next halfedge around the current vertex that doesn't
                 // have a flip edge defined
-                HalfEdgeIter nextHe = he->next;
-                while (hasFlipEdge[nextHe]) {
-                    nextHe = nextHe->flip->next;
+                HalfEdgeHandle nextHe = mesh.next(he);
+                while (hasFlipEdge[nextHe.index]) {
+                    nextHe = mesh.next(mesh.flip(nextHe));
                 }
                 
                 // set attritubes for new halfedge
-                newHe->flip = he;
-                newHe->vertex = nextHe->vertex;
-                newHe->edge = he->edge;
-                newHe->face = newFace;
-                newHe->uv = nextHe->uv;
+                mesh.flip(newHe) = he;
+                mesh.vertex(newHe) = mesh.vertex(nextHe);
+                mesh.edge(newHe) = mesh.edge(he);
+                mesh.face(newHe) = newFace;
+                mesh.halfEdges[newHe.index].uv = mesh.halfEdges[nextHe.index].uv;
+                mesh.halfEdges[newHe.index].normal.setZero();
                 
                 // set face's halfedge to boundary halfedge
-                newFace->he = newHe;
+                mesh.he(newFace) = newHe;
                 
                 boundaryCycle.push_back(newHe);
                 
@@ -327,100 +483,1001 @@ bool MeshIO::buildMesh(const MeshData& data, Mesh& mesh)
             // link the cycle of boundary halfedges together
             int n = (int)boundaryCycle.size();
             for (int i = 0; i < n; i++) {
-                boundaryCycle[i]->next = boundaryCycle[(i+n-1)%n];
-                hasFlipEdge[boundaryCycle[i]] = true;
-                hasFlipEdge[boundaryCycle[i]->flip] = true;
+                mesh.next(boundaryCycle[i]) = boundaryCycle[(i+n-1)%n];
+                hasFlipEdge[boundaryCycle[i].index] = true;
+                hasFlipEdge[mesh.flip(boundaryCycle[i]).index] = true;
             }
             mesh.boundaries.insert(mesh.boundaries.end(), boundaryCycle[0]);
         }
     }
     
     indexElements(mesh);
-    checkIsolatedVertices(mesh);
-    checkNonManifoldVertices(mesh);
+    markBoundaryVertices(mesh);
+    validateAfterRead(mesh);
     
     return true;
 }
 
-bool MeshIO::read(std::ifstream& in, Mesh& mesh)
+// skips spaces and tabs, and joins lines continued with a backslash
+inline const char *skipSpaces(const char *p, const char *end)
+{
+    while (p < end) {
+        if (*p == ' ' || *p == '\t' || *p == '\r') {
+            p++;
+            
+        } else if (*p == '\\' && p + 1 < end && (p[1] == '\n' || p[1] == '\r')) {
+            p++;
+            if (*p == '\r' && p + 1 < end && p[1] == '\n') p++;
+            p++;
+            
+        } else {
+            break;
+        }
+    }
+    
+    return p;
+}
+
+// returns the start of the next line
+inline const char *skipLine(const char *p, const char *end)
+{
+    const char *newline = (const char *)memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+// parses a decimal integer without consulting the locale
+inline bool parseInt(const char *& p, const char *end, int& value)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    
+    const char *start = p;
+    long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = 10*v + (*p++ - '0');
+    }
+    
+    value = (int)(negative ? -v : v);
+    return p != start;
+}
+
+// numbers with at most 19 significant digits and small exponents are converted
+// exactly, as in Clinger's fast path, others are scaled in extended precision
+bool parseDouble(const char *& p, const char *end, double& value)
 {
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    
+    // inf and nan
+    if (p < end && (*p == 'i' || *p == 'I' || *p == 'n' || *p == 'N')) {
+        value = (*p == 'n' || *p == 'N') ? NAN : (negative ? -INFINITY : INFINITY);
+        while (p < end && isalpha(*p)) p++;
+        return true;
+    }
+    
+    // accumulate up to 19 significant digits
+    const char *start = p;
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 19) {
+            mantissa = 10*mantissa + (*p - '0');
+            if (mantissa > 0) digits++;
+        } else {
+            exponent++;
+        }
+        p++;
+    }
+    
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) {
+                mantissa = 10*mantissa + (*p - '0');
+                if (mantissa > 0) digits++;
+                exponent--;
+            }
+            p++;
+        }
+    }
+    
+    if (p == start || (p == start + 1 && *start == '.')) return false;
+    
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        int exp = 0;
+        if (parseInt(e, end, exp)) {
+            exponent += exp;
+            p = e;
+        }
+    }
+    
+    double v;
+    if (mantissa == 0) {
+        v = 0.0;
+        
+    } else if (mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        v = (double)mantissa;
+        v = exponent < 0 ? v / powers[-exponent] : v * powers[exponent];
+        
+    } else {
+        v = (double)((long double)mantissa * powl(10.0L, (long double)exponent));
+    }
+    
+    value = negative ? -v : v;
+    return true;
+}
+
+// parses an obj vertex reference of the form v, v/vt, v//vn or v/vt/vn.
+// References are converted to 0-based indices, negative references are
+// relative to the current end of the element lists, and missing ones are -1.
+// A reference of 0 or one before the start of its list resolves past the end
+// of every list, so that buildMesh rejects it instead of reading it as missing
+inline bool parseIndex(const char *& p, const char *end, const MeshData& data, Index& index)
+{
+    int counts[3] = {(int)data.positions.size(), (int)data.uvs.size(), (int)data.normals.size()};
+    int values[3] = {-1, -1, -1};
+    
+    for (int i = 0; i < 3; i++) {
+        int reference;
+        if (parseInt(p, end, reference)) {
+            values[i] = reference > 0 ? reference - 1 : counts[i] + reference;
+            if (reference == 0 || values[i] < 0) values[i] = INT_MAX;
+        
+        } else if (i == 0) {
+            return false;
+        }
+        
+        if (i < 2 && p < end && *p == '/') p++;
+        else break;
+    }
+    
+    index = Index(values[0], values[1], values[2]);
+    return true;
+}
+
+bool MeshIO::parse(const char *begin, const char *end, MeshData& data)
+{
+    const char *p = begin;
+    while (p < end) {
+        p = skipSpaces(p, end);
+        
+        if (p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            double x = 0, y = 0, z = 0;
+            p = skipSpaces(p + 2, end); parseDouble(p, end, x);
+            p = skipSpaces(p, end); parseDouble(p, end, y);
+            p = skipSpaces(p, end); parseDouble(p, end, z);
+            
+            data.positions.push_back(Vector3s(x, y, z));
+            
+        } else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            double u = 0, v = 0;
+            p = skipSpaces(p + 3, end); parseDouble(p, end, u);
+            p = skipSpaces(p, end); parseDouble(p, end, v);
+            
+            data.uvs.push_back(Vector3s(u, v, 0));
+            
+        } else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            double x = 0, y = 0, z = 0;
+            p = skipSpaces(p + 3, end); parseDouble(p, end, x);
+            p = skipSpaces(p, end); parseDouble(p, end, y);
+            p = skipSpaces(p, end); parseDouble(p, end, z);
+            
+            data.normals.push_back(Vector3s(x, y, z));
+            
+        } else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            p = skipSpaces(p + 2, end);
+            
+            Index index;
+            while (p < end && *p != '\n' && parseIndex(p, end, data, index)) {
+                data.indices.push_back(index);
+                p = skipSpaces(p, end);
+            }
+            
+            data.endFace();
+        }
+        
+        p = skipLine(p, end);
+    }
+    
+    return true;
+}
+
+bool MeshIO::read(const std::string& fileName, Mesh& mesh)
+{
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file for reading" << std::endl;
+        return false;
+    }
+    
+    struct stat info;
+    size_t size = fstat(fd, &info) == 0 ? (size_t)info.st_size : 0;
+    
+    // map file and parse it in place
     MeshData data;
+    if (size > 0) {
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            std::cerr << "Error: Could not map file for reading" << std::endl;
+            close(fd);
+            return false;
+        }
+        
+        madvise(map, size, MADV_SEQUENTIAL);
+        const char *begin = (const char *)map;
+        parse(begin, begin + size, data);
+        munmap(map, size);
+    }
+    close(fd);
+    
+    return buildMesh(data, mesh);
+}
+
+// elements formatted per task when writing obj files
+#define WRITE_CHUNK_SIZE 16384
+
+// formats x with %g and replaces the locale's decimal point, which may span several
+// bytes, with '.'. %g emits no grouping, so any other byte belongs to the decimal point
+int formatDouble(char *buffer, size_t size, double x, int precision)
+{
+    int n = snprintf(buffer, size, "%.*g", precision, x);
+    
+    int m = 0;
+    bool point = false;
+    for (int i = 0; i < n; i++) {
+        char c = buffer[i];
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+') {
+            buffer[m++] = c;
+            
+        } else if (!point) {
+            buffer[m++] = '.';
+            point = true;
+        }
+    }
+    
+    return m;
+}
+
+void appendDouble(std::string& s, double x, int precision)
+{
+    char buffer[64];
+    int n = 0;
+    if (precision > 0) {
+        n = formatDouble(buffer, sizeof(buffer), x, precision);
+        
+    } else {
+        for (int p = 15; p <= 17; p++) {
+            n = formatDouble(buffer, sizeof(buffer), x, p);
+            
+            const char *begin = buffer;
+            double y;
+            if (parseDouble(begin, buffer + n, y) && y == x) break;
+        }
+    }
+    
+    s.append(buffer, n);
+}
+
+// appends decimal representation of i
+inline void appendInt(std::string& s, uint32_t i)
+{
+    char buffer[10];
+    int n = 0;
+    do {
+        buffer[n++] = (char)('0' + i % 10);
+        i /= 10;
+    } while (i > 0);
+    
+    while (n > 0) s.push_back(buffer[--n]);
+}
+
+// formats elements [0, n) in chunks on all threads and writes the chunks in order.
+// Chunks are formatted in rounds of a few per thread to bound buffer memory
+template <typename F>
+void writeChunks(std::ofstream& out, int n, int threads, const F& format)
+{
+    int nChunks = (n + WRITE_CHUNK_SIZE - 1) / WRITE_CHUNK_SIZE;
+    int roundSize = 4*resolveThreadCount(threads);
+    std::vector<std::string> buffers(roundSize);
+    
+    for (int first = 0; first < nChunks; first += roundSize) {
+        int last = std::min(nChunks, first + roundSize);
+        
+        parallelFor(first, last, threads, [&](int c) {
+            std::string& buffer = buffers[c - first];
+            buffer.clear();
+            format(c*WRITE_CHUNK_SIZE, std::min(n, (c + 1)*WRITE_CHUNK_SIZE), buffer);
+        }, 1);
+        
+        for (int c = first; c < last; c++) {
+            out.write(buffers[c - first].data(), (std::streamsize)buffers[c - first].size());
+        }
+    }
+}
+
+void MeshIO::write(std::ofstream& out, const Mesh& mesh, int precision)
+{
+    // write vertices
+    writeChunks(out, (int)mesh.vertices.size(), mesh.threads, [&](int begin, int end, std::string& buffer) {
+        for (int i = begin; i < end; i++) {
+            const Vector3s& p = mesh.vertices[i].position;
+            buffer.append("v ");
+            appendDouble(buffer, p.x(), precision);
+            buffer.push_back(' ');
+            appendDouble(buffer, p.y(), precision);
+            buffer.push_back(' ');
+            appendDouble(buffer, p.z(), precision);
+            buffer.push_back('\n');
+        }
+    });
+    
+    // write faces
+    writeChunks(out, (int)mesh.faces.size(), mesh.threads, [&](int begin, int end, std::string& buffer) {
+        for (int i = begin; i < end; i++) {
+            HalfEdgeHandle fHe = mesh.he(FaceHandle(i));
+            HalfEdgeHandle he = fHe;
+            
+            if (mesh.halfEdges[he.index].onBoundary) {
+                continue;
+            }
+            
+            buffer.append("f ");
+            do {
+                appendInt(buffer, mesh.vertex(he).index + 1);
+                buffer.push_back(' ');
+                
+                he = mesh.next(he);
+            } while (he != fHe);
+            
+            buffer.push_back('\n');
+        }
+    });
+}
+
+// binary mesh container: a header followed by arrays in native byte order,
+// each starting at a multiple of BINARY_ALIGNMENT bytes
+#define BINARY_MAGIC "SMESH\0\0"
+#define BINARY_VERSION 1
+#define BINARY_ALIGNMENT 64
+#define BINARY_CONNECTIVITY 1
+
+enum BinarySection {
+    POSITIONS,       // 3 doubles per vertex
+    FACE_OFFSETS,    // nFaces + 1 uint32s into FACE_INDICES
+    FACE_INDICES,    // vertex indices of non boundary faces
+    HE_NEXT,         // uint32 per halfedge, as are the following four
+    HE_FLIP,
+    HE_VERTEX,
+    HE_EDGE,
+    HE_FACE,
+    HE_ON_BOUNDARY,  // uint8 per halfedge
+    VERTEX_HE,       // uint32 per vertex, 0xffffffff if isolated
+    EDGE_HE,         // uint32 per edge
+    FACE_HE,         // uint32 per face, including boundary faces
+    BOUNDARIES,      // uint32 per boundary cycle
+    SECTION_COUNT
+};
+
+class BinaryHeader {
+public:
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    
+    // element counts
+    uint64_t nVertices;
+    uint64_t nFaces;
+    uint64_t nIndices;
+    uint64_t nHalfEdges;
+    uint64_t nEdges;
+    uint64_t nAllFaces;
+    uint64_t nBoundaries;
+    
+    // byte offset and size of each section
+    uint64_t offsets[SECTION_COUNT];
+    uint64_t sizes[SECTION_COUNT];
+};
+
+static_assert(sizeof(HalfEdgeHandle) == sizeof(uint32_t), "handles must be 32 bit");
+
+// appends a section and records its location in the header
+void writeSection(std::ofstream& out, BinaryHeader& header, BinarySection section,
+                  const void *data, size_t size)
+{
+    static const char zeros[BINARY_ALIGNMENT] = {0};
+    
+    uint64_t offset = (uint64_t)out.tellp();
+    uint64_t padding = (BINARY_ALIGNMENT - offset % BINARY_ALIGNMENT) % BINARY_ALIGNMENT;
+    out.write(zeros, (std::streamsize)padding);
+    
+    header.offsets[section] = offset + padding;
+    header.sizes[section] = size;
+    if (size > 0) out.write((const char *)data, (std::streamsize)size);
+}
+
+// copies a section of handles into a vector, checking that each one refers to
+// an element in [0, bound) or is invalid when allowed
+template <typename T>
+bool copyHandles(const char *base, const BinaryHeader& header, BinarySection section,
+                 uint64_t count, uint64_t bound, bool allowInvalid, std::vector<Handle<T>>& handles)
+{
+    if (header.sizes[section] != count*sizeof(uint32_t)) return false;
+    
+    handles.resize(count);
+    if (count > 0) memcpy(&handles[0], base + header.offsets[section], header.sizes[section]);
+    
+    for (size_t i = 0; i < handles.size(); i++) {
+        if (handles[i].index >= bound && !(allowInvalid && !handles[i].isValid())) return false;
+    }
+    
+    return true;
+}
+
+bool MeshIO::writeBinary(const std::string& fileName, const Mesh& mesh, bool connectivity)
+{
+    std::ofstream out(fileName.c_str(), std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open file for writing" << std::endl;
+        return false;
+    }
+    
+    BinaryHeader header;
+    memset(&header, 0, sizeof(BinaryHeader));
+    memcpy(header.magic, BINARY_MAGIC, 8);
+    header.version = BINARY_VERSION;
+    header.flags = connectivity ? BINARY_CONNECTIVITY : 0;
+    out.write((const char *)&header, sizeof(BinaryHeader));
+    
+    // positions
+    std::vector<double> positions(3*mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const Vector3s& p = mesh.vertices[i].position;
+        positions[3*i] = p.x();
+        positions[3*i+1] = p.y();
+        positions[3*i+2] = p.z();
+    }
+    header.nVertices = mesh.vertices.size();
+    writeSection(out, header, POSITIONS, positions.data(), positions.size()*sizeof(double));
+    
+    // faces
+    std::vector<uint32_t> offsets(1, 0);
+    std::vector<uint32_t> indices;
+    for (FaceCIter f = mesh.faces.begin(); f != mesh.faces.end(); f++) {
+        if (f->isBoundary(mesh)) continue;
+        
+        HalfEdgeHandle fHe = mesh.he(FaceHandle(f->index));
+        HalfEdgeHandle h = fHe;
+        do {
+            indices.push_back(mesh.vertex(h).index);
+            
+            h = mesh.next(h);
+        } while (h != fHe);
+        offsets.push_back((uint32_t)indices.size());
+    }
+    header.nFaces = offsets.size() - 1;
+    header.nIndices = indices.size();
+    writeSection(out, header, FACE_OFFSETS, offsets.data(), offsets.size()*sizeof(uint32_t));
+    writeSection(out, header, FACE_INDICES, indices.data(), indices.size()*sizeof(uint32_t));
+    
+    // connectivity
+    if (connectivity) {
+        size_t nHE = mesh.halfEdges.size();
+        std::vector<uint8_t> onBoundary(nHE);
+        for (size_t i = 0; i < nHE; i++) {
+            onBoundary[i] = mesh.halfEdges[i].onBoundary;
+        }
+        
+        header.nHalfEdges = nHE;
+        header.nEdges = mesh.edges.size();
+        header.nAllFaces = mesh.faces.size();
+        header.nBoundaries = mesh.boundaries.size();
+        writeSection(out, header, HE_NEXT, mesh.heNext.data(), nHE*sizeof(uint32_t));
+        writeSection(out, header, HE_FLIP, mesh.heFlip.data(), nHE*sizeof(uint32_t));
+        writeSection(out, header, HE_VERTEX, mesh.heVertex.data(), nHE*sizeof(uint32_t));
+        writeSection(out, header, HE_EDGE, mesh.heEdge.data(), nHE*sizeof(uint32_t));
+        writeSection(out, header, HE_FACE, mesh.heFace.data(), nHE*sizeof(uint32_t));
+        writeSection(out, header, HE_ON_BOUNDARY, onBoundary.data(), nHE);
+        writeSection(out, header, VERTEX_HE, mesh.vertexHe.data(), mesh.vertexHe.size()*sizeof(uint32_t));
+        writeSection(out, header, EDGE_HE, mesh.edgeHe.data(), mesh.edgeHe.size()*sizeof(uint32_t));
+        writeSection(out, header, FACE_HE, mesh.faceHe.data(), mesh.faceHe.size()*sizeof(uint32_t));
+        writeSection(out, header, BOUNDARIES, mesh.boundaries.data(), mesh.boundaries.size()*sizeof(uint32_t));
+    }
+    
+    // rewrite header with section table
+    out.seekp(0);
+    out.write((const char *)&header, sizeof(BinaryHeader));
+    
+    return out.good();
+}
+
+bool MeshIO::readBinary(const std::string& fileName, Mesh& mesh)
+{
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file for reading" << std::endl;
+        return false;
+    }
+    
+    struct stat info;
+    size_t size = fstat(fd, &info) == 0 ? (size_t)info.st_size : 0;
+    void *map = size >= sizeof(BinaryHeader) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    
+    if (map == MAP_FAILED) {
+        std::cerr << "Error: Could not map file for reading" << std::endl;
+        return false;
+    }
+    
+    const char *base = (const char *)map;
+    BinaryHeader header;
+    memcpy(&header, base, sizeof(BinaryHeader));
+    
+    // check header and section bounds
+    bool valid = memcmp(header.magic, BINARY_MAGIC, 8) == 0 && header.version == BINARY_VERSION;
+    for (int i = 0; i < SECTION_COUNT && valid; i++) {
+        valid = header.offsets[i] <= size && header.sizes[i] <= size - header.offsets[i];
+    }
+    
+    valid = valid && header.sizes[POSITIONS] == 3*header.nVertices*sizeof(double) &&
+                     header.sizes[FACE_OFFSETS] == (header.nFaces + 1)*sizeof(uint32_t) &&
+                     header.sizes[FACE_INDICES] == header.nIndices*sizeof(uint32_t) &&
+                     header.nVertices < 0xffffffff && header.nIndices < 0xffffffff;
+    
+    if (!valid) {
+        std::cerr << "Error: " << fileName << " is not a valid binary mesh file" << std::endl;
+        munmap(map, size);
+        return false;
+    }
+    
+    const double *positions = (const double *)(base + header.offsets[POSITIONS]);
+    bool success = true;
     
-    // parse obj format
-    std::string line;
-    while(getline(in, line)) {
-        std::stringstream ss(line);
-        std::string token;
+    if (header.flags & BINARY_CONNECTIVITY) {
+        // copy prebuilt connectivity in bulk
+        uint64_t nV = header.nVertices, nE = header.nEdges, nF = header.nAllFaces;
+        uint64_t nHE = header.nHalfEdges;
         
-        ss >> token;
+        preallocateMeshElements(MeshData(), 0, mesh);
+        success = nHE < 0xffffffff && nE < 0xffffffff && nF < 0xffffffff &&
+                  header.sizes[HE_ON_BOUNDARY] == nHE &&
+                  copyHandles(base, header, HE_NEXT, nHE, nHE, false, mesh.heNext) &&
+                  copyHandles(base, header, HE_FLIP, nHE, nHE, false, mesh.heFlip) &&
+                  copyHandles(base, header, HE_VERTEX, nHE, nV, false, mesh.heVertex) &&
+                  copyHandles(base, header, HE_EDGE, nHE, nE, false, mesh.heEdge) &&
+                  copyHandles(base, header, HE_FACE, nHE, nF, false, mesh.heFace) &&
+                  copyHandles(base, header, VERTEX_HE, nV, nHE, true, mesh.vertexHe) &&
+                  copyHandles(base, header, EDGE_HE, nE, nHE, false, mesh.edgeHe) &&
+                  copyHandles(base, header, FACE_HE, nF, nHE, false, mesh.faceHe) &&
+                  copyHandles(base, header, BOUNDARIES, header.nBoundaries, nHE, false, mesh.boundaries);
         
-        if (token == "v") {
-            double x, y, z;
-            ss >> x >> y >> z;
+        // boundary vertices are marked by walking one rings before the mesh is validated,
+        // broken cycles would never return to their start
+        success = success && checkCycles(mesh);
+        
+        if (success) {
+            mesh.vertices.resize(nV);
+            for (size_t i = 0; i < nV; i++) {
+                Vertex& v = mesh.vertices[i];
+                v.position = Vector3s(positions[3*i], positions[3*i+1], positions[3*i+2]);
+                v.remove = false;
+                v.locked = false;
+            }
             
-            data.positions.push_back(Eigen::Vector3d(x, y, z));
+            const uint8_t *onBoundary = (const uint8_t *)(base + header.offsets[HE_ON_BOUNDARY]);
+            mesh.halfEdges.resize(nHE);
+            for (size_t i = 0; i < nHE; i++) {
+                HalfEdge& h = mesh.halfEdges[i];
+                h.uv.setZero();
+                h.normal.setZero();
+                h.onBoundary = onBoundary[i] != 0;
+                h.remove = false;
+            }
+            
+            mesh.edges.resize(nE);
+            for (size_t i = 0; i < nE; i++) {
+                mesh.edges[i].remove = false;
+            }
             
-        } else if (token == "vt") {
-            double u, v;
-            ss >> u >> v;
+            mesh.faces.resize(nF);
+            for (size_t i = 0; i < nF; i++) {
+                mesh.faces[i].remove = false;
+            }
+            
+            indexElements(mesh);
+            markBoundaryVertices(mesh);
+            validateAfterRead(mesh);
+            
+        } else {
+            std::cerr << "Error: " << fileName << " has invalid connectivity" << std::endl;
+        }
+        
+    } else {
+        // build connectivity from faces
+        MeshData data;
+        data.positions.resize(header.nVertices);
+        for (size_t i = 0; i < header.nVertices; i++) {
+            data.positions[i] = Vector3s(positions[3*i], positions[3*i+1], positions[3*i+2]);
+        }
+        
+        const uint32_t *offsets = (const uint32_t *)(base + header.offsets[FACE_OFFSETS]);
+        const uint32_t *indices = (const uint32_t *)(base + header.offsets[FACE_INDICES]);
+        data.faceOffsets.assign(offsets, offsets + header.nFaces + 1);
+        data.indices.resize(header.nIndices);
+        for (size_t i = 0; i < header.nIndices; i++) {
+            data.indices[i] = Index((int)indices[i], -1, -1);
+        }
+        
+        for (size_t i = 0; i < header.nFaces && success; i++) {
+            success = offsets[i] <= offsets[i+1] && offsets[i+1] <= header.nIndices;
+        }
+        
+        if (success) {
+            success = buildMesh(data, mesh);
             
-            data.uvs.push_back(Eigen::Vector3d(u,v,0));
+        } else {
+            std::cerr << "Error: " << fileName << " has invalid faces" << std::endl;
+        }
+    }
+    
+    munmap(map, size);
+    
+    return success;
+}
+
+enum PlyType {
+    PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64,
+    PLY_INVALID
+};
+
+class PlyProperty {
+public:
+    std::string name;
+    PlyType type;
+    
+    // type of the element count for list properties, PLY_INVALID otherwise
+    PlyType countType;
+};
+
+class PlyElement {
+public:
+    std::string name;
+    size_t count;
+    std::vector<PlyProperty> properties;
+};
+
+PlyType plyType(const std::string& name)
+{
+    if (name == "char" || name == "int8") return PLY_INT8;
+    if (name == "uchar" || name == "uint8") return PLY_UINT8;
+    if (name == "short" || name == "int16") return PLY_INT16;
+    if (name == "ushort" || name == "uint16") return PLY_UINT16;
+    if (name == "int" || name == "int32") return PLY_INT32;
+    if (name == "uint" || name == "uint32") return PLY_UINT32;
+    if (name == "float" || name == "float32") return PLY_FLOAT32;
+    if (name == "double" || name == "float64") return PLY_FLOAT64;
+    
+    return PLY_INVALID;
+}
+
+int plyTypeSize(PlyType type)
+{
+    static const int sizes[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+    return sizes[type];
+}
+
+bool hostIsLittleEndian()
+{
+    uint16_t one = 1;
+    return *(const uint8_t *)&one == 1;
+}
+
+// reads one binary value of the given type, swapping bytes if the file's byte order differs
+inline double readPlyValue(const char *p, PlyType type, bool swap)
+{
+    unsigned char bytes[8];
+    int size = plyTypeSize(type);
+    memcpy(bytes, p, size);
+    if (swap) std::reverse(bytes, bytes + size);
+    
+    switch (type) {
+        case PLY_INT8: return (double)*(const int8_t *)bytes;
+        case PLY_UINT8: return (double)*(const uint8_t *)bytes;
+        case PLY_INT16: { int16_t v; memcpy(&v, bytes, 2); return (double)v; }
+        case PLY_UINT16: { uint16_t v; memcpy(&v, bytes, 2); return (double)v; }
+        case PLY_INT32: { int32_t v; memcpy(&v, bytes, 4); return (double)v; }
+        case PLY_UINT32: { uint32_t v; memcpy(&v, bytes, 4); return (double)v; }
+        case PLY_FLOAT32: { float v; memcpy(&v, bytes, 4); return (double)v; }
+        case PLY_FLOAT64: { double v; memcpy(&v, bytes, 8); return v; }
+        default: return 0.0;
+    }
+}
+
+// parses the ply header, leaving p at the start of the data
+bool parsePlyHeader(const char *& p, const char *end, int& format, std::vector<PlyElement>& elements)
+{
+    format = -1;
+    bool magic = false;
+    
+    while (p < end) {
+        const char *eol = skipLine(p, end);
+        std::stringstream line(std::string(p, eol));
+        p = eol;
+        
+        std::string keyword;
+        line >> keyword;
+        
+        if (!magic) {
+            if (keyword != "ply") return false;
+            magic = true;
             
-        } else if (token == "vn") {
-            double x, y, z;
-            ss >> x >> y >> z;
+        } else if (keyword == "format") {
+            std::string name;
+            line >> name;
+            if (name == "ascii") format = 0;
+            else if (name == "binary_little_endian") format = 1;
+            else if (name == "binary_big_endian") format = 2;
             
-            data.normals.push_back(Eigen::Vector3d(x, y, z));
+        } else if (keyword == "element") {
+            PlyElement element;
+            line >> element.name >> element.count;
+            elements.push_back(element);
             
-        } else if (token == "f") {
-            std::vector<Index> faceIndices;
+        } else if (keyword == "property") {
+            if (elements.empty()) return false;
             
-            while (ss >> token) {
-                Index index = parseFaceIndex(token);
-                if (index.position < 0) {
-                    getline(in, line);
-                    size_t i = line.find_first_not_of("\t\n\v\f\r ");
-                    index = parseFaceIndex(line.substr(i));
+            PlyProperty property;
+            std::string type;
+            line >> type;
+            if (type == "list") {
+                std::string countType, itemType;
+                line >> countType >> itemType;
+                property.countType = plyType(countType);
+                property.type = plyType(itemType);
+                if (property.countType == PLY_INVALID) return false;
+                
+            } else {
+                property.countType = PLY_INVALID;
+                property.type = plyType(type);
+            }
+            
+            if (property.type == PLY_INVALID) return false;
+            line >> property.name;
+            elements.back().properties.push_back(property);
+            
+        } else if (keyword == "end_header") {
+            return format >= 0;
+        }
+    }
+    
+    return false;
+}
+
+bool MeshIO::readPly(const std::string& fileName, Mesh& mesh)
+{
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file for reading" << std::endl;
+        return false;
+    }
+    
+    struct stat info;
+    size_t size = fstat(fd, &info) == 0 ? (size_t)info.st_size : 0;
+    void *map = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    
+    if (map == MAP_FAILED) {
+        std::cerr << "Error: Could not map file for reading" << std::endl;
+        return false;
+    }
+    
+    const char *p = (const char *)map;
+    const char *end = p + size;
+    
+    int format;
+    std::vector<PlyElement> elements;
+    bool success = parsePlyHeader(p, end, format, elements);
+    bool swap = format == (hostIsLittleEndian() ? 2 : 1);
+    
+    MeshData data;
+    for (size_t e = 0; e < elements.size() && success; e++) {
+        const PlyElement& element = elements[e];
+        const std::vector<PlyProperty>& properties = element.properties;
+        bool isVertex = element.name == "vertex";
+        bool isFace = element.name == "face";
+        
+        // locate positions and face indices
+        int xyz[3] = {-1, -1, -1};
+        int indices = -1;
+        bool fixedSize = true;
+        int stride = 0;
+        std::vector<int> offsets(properties.size());
+        for (int i = 0; i < (int)properties.size(); i++) {
+            const PlyProperty& property = properties[i];
+            if (property.name == "x") xyz[0] = i;
+            else if (property.name == "y") xyz[1] = i;
+            else if (property.name == "z") xyz[2] = i;
+            else if (property.name == "vertex_indices" || property.name == "vertex_index") indices = i;
+            
+            offsets[i] = stride;
+            if (property.countType != PLY_INVALID) fixedSize = false;
+            stride += plyTypeSize(property.type);
+        }
+        
+        if (isVertex && (xyz[0] < 0 || xyz[1] < 0 || xyz[2] < 0)) success = false;
+        if (isFace && (indices < 0 || properties[indices].countType == PLY_INVALID)) success = false;
+        if (!success) break;
+        
+        if (isVertex) data.positions.resize(element.count);
+        if (isFace) data.faceOffsets.reserve(element.count + 1);
+        
+        if (format == 0) {
+            // ascii, one element per line
+            for (size_t i = 0; i < element.count && success; i++) {
+                for (int j = 0; j < (int)properties.size() && success; j++) {
+                    int n = 1;
+                    if (properties[j].countType != PLY_INVALID) {
+                        p = skipSpaces(p, end);
+                        success = parseInt(p, end, n) && n >= 0;
+                    }
+                    
+                    for (int k = 0; k < n && success; k++) {
+                        double value;
+                        p = skipSpaces(p, end);
+                        if (!parseDouble(p, end, value)) {
+                            success = false;
+                            break;
+                        }
+                        
+                        if (isVertex && j == xyz[0]) data.positions[i].x() = value;
+                        else if (isVertex && j == xyz[1]) data.positions[i].y() = value;
+                        else if (isVertex && j == xyz[2]) data.positions[i].z() = value;
+                        else if (isFace && j == indices) data.indices.push_back(Index((int)value, -1, -1));
+                    }
                 }
                 
-                faceIndices.push_back(index);
+                if (isFace) data.endFace();
+                p = skipLine(p, end);
+            }
+            
+        } else if (fixedSize) {
+            // fixed size records are read with a constant stride
+            if ((size_t)(end - p) / (stride > 0 ? stride : 1) < element.count) {
+                success = false;
+                break;
             }
             
-            data.indices.push_back(faceIndices);
+            if (isVertex) {
+                const PlyType x = properties[xyz[0]].type, y = properties[xyz[1]].type, z = properties[xyz[2]].type;
+                for (size_t i = 0; i < element.count; i++) {
+                    const char *record = p + i*stride;
+                    data.positions[i] = Vector3s(readPlyValue(record + offsets[xyz[0]], x, swap),
+                                                 readPlyValue(record + offsets[xyz[1]], y, swap),
+                                                 readPlyValue(record + offsets[xyz[2]], z, swap));
+                }
+            }
+            
+            p += element.count*stride;
+            
+        } else {
+            // variable size records are walked property by property
+            for (size_t i = 0; i < element.count && success; i++) {
+                for (int j = 0; j < (int)properties.size() && success; j++) {
+                    const PlyProperty& property = properties[j];
+                    int itemSize = plyTypeSize(property.type);
+                    
+                    size_t n = 1;
+                    if (property.countType != PLY_INVALID) {
+                        int countSize = plyTypeSize(property.countType);
+                        if (end - p < countSize) { success = false; break; }
+                        
+                        double count = readPlyValue(p, property.countType, swap);
+                        if (count < 0) { success = false; break; }
+                        
+                        n = (size_t)count;
+                        p += countSize;
+                    }
+                    
+                    if ((size_t)(end - p) / itemSize < n) { success = false; break; }
+                    
+                    if (isVertex && (j == xyz[0] || j == xyz[1] || j == xyz[2])) {
+                        int axis = j == xyz[0] ? 0 : (j == xyz[1] ? 1 : 2);
+                        data.positions[i][axis] = readPlyValue(p, property.type, swap);
+                        
+                    } else if (isFace && j == indices) {
+                        for (size_t k = 0; k < n; k++) {
+                            data.indices.push_back(Index((int)readPlyValue(p + k*itemSize, property.type, swap), -1, -1));
+                        }
+                    }
+                    
+                    p += n*itemSize;
+                }
+                
+                if (isFace) data.endFace();
+            }
         }
     }
     
+    munmap(map, size);
+    
+    if (!success) {
+        std::cerr << "Error: " << fileName << " is not a valid ply file" << std::endl;
+        return false;
+    }
+    
     return buildMesh(data, mesh);
 }
 
-void MeshIO::write(std::ofstream& out, const Mesh& mesh)
+bool MeshIO::writePly(const std::string& fileName, const Mesh& mesh)
 {
-    std::unordered_map<std::string, int> vertexMap;
+    std::ofstream out(fileName.c_str(), std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open file for writing" << std::endl;
+        return false;
+    }
     
-    // write vertices
-    for (VertexCIter v = mesh.vertices.begin(); v != mesh.vertices.end(); v++) {
-        out << "v " << v->position.x() << " "
-                    << v->position.y() << " "
-                    << v->position.z() << std::endl;
+    // count faces
+    size_t nF = 0;
+    for (FaceCIter f = mesh.faces.begin(); f != mesh.faces.end(); f++) {
+        if (!f->isBoundary(mesh)) nF++;
     }
     
-    // write faces
+    // header, positions are written at their storage precision
+    const char *scalarType = sizeof(Scalar) == sizeof(float) ? "float" : "double";
+    std::stringstream header;
+    header << "ply\n"
+           << "format " << (hostIsLittleEndian() ? "binary_little_endian" : "binary_big_endian") << " 1.0\n"
+           << "element vertex " << mesh.vertices.size() << "\n"
+           << "property " << scalarType << " x\n"
+           << "property " << scalarType << " y\n"
+           << "property " << scalarType << " z\n"
+           << "element face " << nF << "\n"
+           << "property list uchar int vertex_indices\n"
+           << "end_header\n";
+    out << header.str();
+    
+    // vertex block
+    std::vector<Scalar> positions(3*mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const Vector3s& p = mesh.vertices[i].position;
+        positions[3*i] = p.x();
+        positions[3*i+1] = p.y();
+        positions[3*i+2] = p.z();
+    }
+    out.write((const char *)positions.data(), (std::streamsize)(positions.size()*sizeof(Scalar)));
+    
+    // face block
+    std::vector<char> faces;
+    faces.reserve(nF*(1 + 3*sizeof(int32_t)));
     for (FaceCIter f = mesh.faces.begin(); f != mesh.faces.end(); f++) {
-        HalfEdgeIter he = f->he;
+        if (f->isBoundary(mesh)) continue;
         
-        if (he->onBoundary) {
-            continue;
-        }
+        size_t start = faces.size();
+        faces.push_back(0);
         
-        out << "f ";
-        int j = 0;
+        HalfEdgeHandle fHe = mesh.he(FaceHandle(f->index));
+        HalfEdgeHandle h = fHe;
+        int n = 0;
         do {
-            out << he->vertex->index + 1 << " ";
-            j++;
+            int32_t index = (int32_t)mesh.vertex(h).index;
+            faces.insert(faces.end(), (const char *)&index, (const char *)&index + sizeof(int32_t));
+            n++;
             
-            he = he->next;
-        } while (he != f->he);
+            h = mesh.next(h);
+        } while (h != fHe);
         
-        out << std::endl;
+        if (n > 255) {
+            std::cerr << "Error: face " << f->index << " has too many vertices for ply output" << std::endl;
+            return false;
+        }
+        faces[start] = (char)n;
     }
+    out.write(faces.data(), (std::streamsize)faces.size());
+    
+    return out.good();
 }
@@ -3,32 +3,119 @@
 
 #include <fstream>
 #include "Types.h"
+#include "Validation.h"
 
-class MeshData;
+class Index {
+public:
+    Index() {}
+    
+    Index(int v, int vt, int vn): position(v), uv(vt), normal(vn) {}
+    
+    bool operator<(const Index& i) const {
+        if (position < i.position) return true;
+        if (position > i.position) return false;
+        if (uv < i.uv) return true;
+        if (uv > i.uv) return false;
+        if (normal < i.normal) return true;
+        if (normal > i.normal) return false;
+        
+        return false;
+    }
+    
+    int position;
+    int uv;
+    int normal;
+};
+
+class MeshData {
+public:
+    // default constructor
+    MeshData(): faceOffsets(1, 0) {}
+    
+    // returns number of faces
+    int nFaces() const { return (int)faceOffsets.size() - 1; }
+    
+    // returns number of indices in face f
+    int faceSize(int f) const { return (int)(faceOffsets[f+1] - faceOffsets[f]); }
+    
+    // returns indices of face f
+    const Index *face(int f) const { return &indices[faceOffsets[f]]; }
+    
+    // closes the face formed by the indices added since the last face
+    void endFace() { faceOffsets.push_back((uint32_t)indices.size()); }
+    
+    std::vector<Vector3s> positions;
+    std::vector<Vector3s> uvs;
+    std::vector<Vector3s> normals;
+    
+    // indices of all faces stored back to back, face f spans
+    // [faceOffsets[f], faceOffsets[f+1])
+    std::vector<Index> indices;
+    std::vector<uint32_t> faceOffsets;
+};
+
+// appends x with the given number of significant digits, or the shortest
+// representation that reads back exactly if precision is 0. The decimal point is
+// always '.', whatever the current locale
+void appendDouble(std::string& s, double x, int precision);
+
+// parses a floating point number in [p, end) without consulting the locale and
+// advances p past it
+bool parseDouble(const char *& p, const char *end, double& value);
 
 class MeshIO {
 public:
     // reads data from obj file
-    static bool read(std::ifstream& in, Mesh& mesh);
+    static bool read(const std::string& fileName, Mesh& mesh);
+    
+    // parses obj data held in memory
+    static bool parse(const char *begin, const char *end, MeshData& data);
+    
+    // writes data in obj format with the given number of significant digits,
+    // 0 writes the shortest representation that reads back exactly
+    static void write(std::ofstream& out, const Mesh& mesh, int precision = 6);
+    
+    // reads binary mesh file through a memory map. If the file holds halfedge
+    // connectivity it is copied in bulk, otherwise the mesh is built from faces
+    static bool readBinary(const std::string& fileName, Mesh& mesh);
     
-    // writes data in obj format
-    static void write(std::ofstream& out, const Mesh& mesh);
+    // writes binary mesh file, optionally including halfedge connectivity
+    static bool writeBinary(const std::string& fileName, const Mesh& mesh, bool connectivity);
+    
+    // reads vertex positions and faces from ascii or binary ply file
+    static bool readPly(const std::string& fileName, Mesh& mesh);
+    
+    // writes vertex positions at their storage precision and faces in binary ply format
+    static bool writePly(const std::string& fileName, const Mesh& mesh);
     
     // sets index for elements
     static  void indexElements(Mesh& mesh);
     
+    // caches which vertices lie on a boundary
+    static void markBoundaryVertices(Mesh& mesh);
+    
+    // builds the halfedge mesh
+    static bool buildMesh(const MeshData& data, Mesh& mesh);
+    
+    // checks mesh at the given level and records problems in report
+    static void validate(const Mesh& mesh, ValidationLevel level, ValidationReport& report);
+    
 private:
     // reserves spave for mesh vertices, uvs, normals and faces
-    static void preallocateMeshElements(const MeshData& data, Mesh& mesh);
+    static void preallocateMeshElements(const MeshData& data, size_t nE, Mesh& mesh);
     
-    // checks if any vertex is not contained in a face
-    static void checkIsolatedVertices(const Mesh& mesh);
+    // checks halfedge connectivity invariants, returns false if any handle is out of range
+    static bool checkConnectivity(const Mesh& mesh, ValidationReport& report);
     
-    // checks if a vertex is non-manifold
-    static void checkNonManifoldVertices(const Mesh& mesh);
+    // checks that next is a permutation and flip pairs halfedges, so every walk
+    // around a face or a vertex returns to where it started
+    static bool checkCycles(const Mesh& mesh);
     
-    // builds the halfedge mesh
-    static bool buildMesh(const MeshData& data, Mesh& mesh);
+    // checks for isolated and nonmanifold vertices
+    static void checkVertices(const Mesh& mesh, ValidationReport& report);
+    
+    // validates mesh with its validation level and warns about problems
+    static void validateAfterRead(Mesh& mesh);
 };
 
 #endif
@@ -0,0 +1,376 @@
+#include "MeshStream.h"
+#include "MeshIO.h"
+#include "Mesh.h"
+#include <sys/mman.h>
+#include <unistd.h>
+
+// reads a 1-based, possibly negative, obj vertex reference and advances str past it
+bool parseVertexReference(const char *& str, uint32_t nV, uint32_t& index)
+{
+    char *end;
+    long i = strtol(str, &end, 10);
+    if (end == str) return false;
+    
+    // skip uv and normal references
+    str = end;
+    while (*str != '\0' && !isspace(*str)) str++;
+    
+    if (i > 0) i -= 1;
+    else i += nV;
+    
+    if (i < 0 || i >= (long)nV) return false;
+    
+    index = (uint32_t)i;
+    return true;
+}
+
+bool MeshStream::split(std::ifstream& in, FILE *positions, FILE *triangles, uint32_t& nV, uint32_t& nT)
+{
+    nV = 0;
+    nT = 0;
+    
+    std::string line;
+    std::vector<uint32_t> face;
+    while (getline(in, line)) {
+        const char *str = line.c_str();
+        while (isspace(*str)) str++;
+        
+        if (str[0] == 'v' && isspace(str[1])) {
+            // parsed as in MeshIO::parse, missing coordinates are 0
+            double p[3] = {0, 0, 0};
+            const char *end = line.c_str() + line.size();
+            str++;
+            for (int i = 0; i < 3; i++) {
+                while (isspace(*str)) str++;
+                parseDouble(str, end, p[i]);
+            }
+            
+            if (fwrite(p, sizeof(double), 3, positions) != 3) {
+                std::cerr << "Error: Could not write temporary file" << std::endl;
+                return false;
+            }
+            nV++;
+            
+        } else if (str[0] == 'f' && isspace(str[1])) {
+            face.clear();
+            str++;
+            while (true) {
+                while (isspace(*str)) str++;
+                if (*str == '\0') break;
+                
+                uint32_t index;
+                if (!parseVertexReference(str, nV, index)) {
+                    std::cerr << "Error: invalid face " << line << std::endl;
+                    return false;
+                }
+                
+                face.push_back(index);
+            }
+            
+            // triangulate as a fan
+            for (size_t i = 2; i < face.size(); i++) {
+                uint32_t t[3] = {face[0], face[i-1], face[i]};
+                if (fwrite(t, sizeof(uint32_t), 3, triangles) != 3) {
+                    std::cerr << "Error: Could not write temporary file" << std::endl;
+                    return false;
+                }
+                nT++;
+            }
+        }
+    }
+    
+    return true;
+}
+
+void MeshStream::simplifyWindow(const std::vector<uint32_t>& triangles, const double *positions,
+                                double ratio, std::unordered_map<uint32_t, uint32_t>& sharedVertices,
+                                uint32_t& nWritten, std::ofstream& out)
+{
+    // vertices on the window border are also referenced by other slabs; find them
+    // from edges used by a single triangle
+    std::unordered_map<uint64_t, int> edgeCount;
+    for (size_t i = 0; i < triangles.size(); i++) {
+        uint64_t a = triangles[i];
+        uint64_t b = triangles[i % 3 == 2 ? i - 2 : i + 1];
+        if (a > b) std::swap(a, b);
+        
+        edgeCount[(a << 32) | b]++;
+    }
+    
+    std::unordered_map<uint32_t, uint32_t> localIndex;
+    std::vector<uint32_t> globalIndex;
+    for (std::unordered_map<uint64_t, int>::const_iterator e = edgeCount.begin(); e != edgeCount.end(); e++) {
+        if (e->second == 1) {
+            uint32_t ends[2] = {(uint32_t)(e->first >> 32), (uint32_t)(e->first & 0xffffffff)};
+            for (int j = 0; j < 2; j++) {
+                if (localIndex.insert(std::make_pair(ends[j], (uint32_t)globalIndex.size())).second) {
+                    globalIndex.push_back(ends[j]);
+                }
+            }
+        }
+    }
+    
+    // border vertices are numbered first. They are locked and never removed, so
+    // compaction after simplification leaves them at the front in the same order
+    uint32_t nLocked = (uint32_t)globalIndex.size();
+    
+    MeshData data;
+    data.indices.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++) {
+        std::pair<std::unordered_map<uint32_t, uint32_t>::iterator, bool> inserted =
+            localIndex.insert(std::make_pair(triangles[i], (uint32_t)globalIndex.size()));
+        if (inserted.second) globalIndex.push_back(triangles[i]);
+        
+        data.indices.push_back(Index(inserted.first->second, -1, -1));
+        if (i % 3 == 2) data.endFace();
+    }
+    
+    data.positions.resize(globalIndex.size());
+    for (size_t i = 0; i < globalIndex.size(); i++) {
+        const double *p = positions + 3*(size_t)globalIndex[i];
+        data.positions[i] = Vector3s(p[0], p[1], p[2]);
+    }
+    
+    Mesh mesh;
+    if (MeshIO::buildMesh(data, mesh)) {
+        for (uint32_t i = 0; i < nLocked; i++) {
+            mesh.vertices[i].locked = true;
+        }
+        
+        mesh.simplify((int)(ratio * triangles.size() / 3));
+        
+    } else {
+        std::cerr << "Warning: writing window with " << triangles.size() / 3
+                  << " faces unsimplified" << std::endl;
+        
+        // emit the input triangles as they are
+        mesh = Mesh();
+        mesh.vertices.resize(globalIndex.size());
+        for (size_t i = 0; i < globalIndex.size(); i++) {
+            mesh.vertices[i].position = data.positions[i];
+        }
+    }
+    
+    // append vertices exactly, reusing border vertices already written by another slab
+    std::vector<uint32_t> outIndex(mesh.vertices.size());
+    std::string line;
+    for (uint32_t i = 0; i < (uint32_t)mesh.vertices.size(); i++) {
+        if (i < nLocked) {
+            std::unordered_map<uint32_t, uint32_t>::const_iterator shared = sharedVertices.find(globalIndex[i]);
+            if (shared != sharedVertices.end()) {
+                outIndex[i] = shared->second;
+                continue;
+            }
+            
+            sharedVertices[globalIndex[i]] = nWritten;
+        }
+        
+        const Vector3s& p = mesh.vertices[i].position;
+        line = "v ";
+        appendDouble(line, p.x(), 0);
+        line.push_back(' ');
+        appendDouble(line, p.y(), 0);
+        line.push_back(' ');
+        appendDouble(line, p.z(), 0);
+        line.push_back('\n');
+        out << line;
+        outIndex[i] = nWritten++;
+    }
+    
+    // append faces
+    if (mesh.faces.empty()) {
+        for (int i = 0; i < data.nFaces(); i++) {
+            const Index *face = data.face(i);
+            out << "f " << outIndex[face[0].position] + 1 << " "
+                        << outIndex[face[1].position] + 1 << " "
+                        << outIndex[face[2].position] + 1 << "\n";
+        }
+        
+    } else {
+        for (FaceCIter f = mesh.faces.begin(); f != mesh.faces.end(); f++) {
+            if (f->isBoundary(mesh)) continue;
+            
+            HalfEdgeHandle fHe = mesh.he(FaceHandle(f->index));
+            HalfEdgeHandle h = fHe;
+            out << "f";
+            do {
+                out << " " << outIndex[mesh.vertex(h).index] + 1;
+                
+                h = mesh.next(h);
+            } while (h != fHe);
+            out << "\n";
+        }
+    }
+}
+
+// histogram bins per slab used to place slab boundaries at centroid quantiles
+#define BINS_PER_SLAB 256
+
+// returns the histogram bin of the centroid of triangle t along axis
+inline int centroidBin(const uint32_t *t, const double *positions, int axis, double min, double extent, int nBins)
+{
+    double c = (positions[3*(size_t)t[0] + axis] + positions[3*(size_t)t[1] + axis] +
+                positions[3*(size_t)t[2] + axis]) / 3.0;
+    
+    return std::max(0, std::min(nBins - 1, (int)(nBins * (c - min) / extent)));
+}
+
+bool MeshStream::simplifySlabs(FILE *triangles, uint32_t nT, const double *positions, int maxWindowFaces,
+                               double ratio, std::unordered_map<uint32_t, uint32_t>& sharedVertices,
+                               uint32_t& nWritten, std::ofstream& out)
+{
+    // centroid bounds of slabs too large to simplify in core
+    Eigen::Vector3d min, max;
+    min.setConstant(INFINITY);
+    max.setConstant(-INFINITY);
+    int axis = 0;
+    double extent = 0;
+    if (nT > (uint32_t)maxWindowFaces) {
+        rewind(triangles);
+        uint32_t t[3];
+        while (fread(t, sizeof(uint32_t), 3, triangles) == 3) {
+            Eigen::Vector3d c = Eigen::Vector3d::Zero();
+            for (int k = 0; k < 3; k++) {
+                const double *p = positions + 3*(size_t)t[k];
+                c += Eigen::Vector3d(p[0], p[1], p[2]);
+            }
+            
+            min = min.cwiseMin(c / 3.0);
+            max = max.cwiseMax(c / 3.0);
+        }
+        
+        extent = (max - min).maxCoeff(&axis);
+    }
+    
+    // small enough, or all centroids coincide and cannot be separated
+    if (!(extent > 0)) {
+        if (nT > (uint32_t)maxWindowFaces) {
+            std::cerr << "Warning: window with " << nT << " faces could not be split" << std::endl;
+        }
+        
+        std::vector<uint32_t> window(3*(size_t)nT);
+        rewind(triangles);
+        if (fread(&window[0], sizeof(uint32_t), window.size(), triangles) != window.size()) return false;
+        
+        simplifyWindow(window, positions, ratio, sharedVertices, nWritten, out);
+        return true;
+    }
+    
+    // histogram of centroids along the longest axis
+    int nBins = BINS_PER_SLAB * (int)((nT + (uint32_t)maxWindowFaces - 1) / (uint32_t)maxWindowFaces);
+    std::vector<uint32_t> bins(nBins, 0);
+    rewind(triangles);
+    uint32_t t[3];
+    while (fread(t, sizeof(uint32_t), 3, triangles) == 3) {
+        bins[centroidBin(t, positions, axis, min[axis], extent, nBins)]++;
+    }
+    
+    // fill slabs with consecutive bins up to maxWindowFaces. A bin larger than
+    // that gets a slab of its own, which is split again below
+    std::vector<int> binSlab(nBins);
+    std::vector<uint32_t> slabFaces(1, 0);
+    for (int i = 0; i < nBins; i++) {
+        if (slabFaces.back() > 0 && slabFaces.back() + bins[i] > (uint32_t)maxWindowFaces) {
+            slabFaces.push_back(0);
+        }
+        
+        binSlab[i] = (int)slabFaces.size() - 1;
+        slabFaces.back() += bins[i];
+    }
+    
+    int nSlabs = (int)slabFaces.size();
+    std::vector<FILE *> slabs(nSlabs, (FILE *)NULL);
+    bool success = true;
+    for (int i = 0; i < nSlabs && success; i++) {
+        slabs[i] = tmpfile();
+        success = slabs[i] != NULL;
+    }
+    
+    if (success) {
+        rewind(triangles);
+        while (success && fread(t, sizeof(uint32_t), 3, triangles) == 3) {
+            FILE *slab = slabs[binSlab[centroidBin(t, positions, axis, min[axis], extent, nBins)]];
+            success = fwrite(t, sizeof(uint32_t), 3, slab) == 3;
+        }
+        
+        if (!success) std::cerr << "Error: Could not write temporary file" << std::endl;
+    }
+    
+    for (int i = 0; i < nSlabs && success; i++) {
+        if (fflush(slabs[i]) != 0) {
+            std::cerr << "Error: Could not write temporary file" << std::endl;
+            success = false;
+            
+        } else if (slabFaces[i] > 0) {
+            success = simplifySlabs(slabs[i], slabFaces[i], positions, maxWindowFaces, ratio,
+                                    sharedVertices, nWritten, out);
+        }
+    }
+    
+    for (int i = 0; i < nSlabs; i++) {
+        if (slabs[i]) fclose(slabs[i]);
+    }
+    
+    return success;
+}
+
+bool MeshStream::simplify(const std::string& inFileName, const std::string& outFileName,
+                          int target, int maxWindowFaces)
+{
+    std::ifstream in(inFileName.c_str());
+    if (!in.is_open()) {
+        std::cerr << "Error: Could not open file for reading" << std::endl;
+        return false;
+    }
+    
+    std::ofstream out(outFileName.c_str());
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open file for writing" << std::endl;
+        return false;
+    }
+    
+    // 1. split input into binary vertex and triangle streams
+    FILE *positions = tmpfile();
+    FILE *triangles = tmpfile();
+    if (!positions || !triangles) {
+        std::cerr << "Error: Could not create temporary files" << std::endl;
+        return false;
+    }
+    
+    uint32_t nV, nT;
+    bool success = split(in, positions, triangles, nV, nT);
+    if (success && (fflush(positions) != 0 || fflush(triangles) != 0)) {
+        std::cerr << "Error: Could not write temporary file" << std::endl;
+        success = false;
+    }
+    
+    void *map = MAP_FAILED;
+    size_t mapSize = 3*sizeof(double)*(size_t)nV;
+    if (success && nV > 0) {
+        map = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fileno(positions), 0);
+        success = map != MAP_FAILED;
+    }
+    
+    // 2. bucket triangles into slabs, simplify them one at a time and stream them
+    // to the output
+    if (success && nT > 0) {
+        double ratio = std::min(1.0, (double)target / nT);
+        std::unordered_map<uint32_t, uint32_t> sharedVertices;
+        uint32_t nWritten = 0;
+        
+        success = simplifySlabs(triangles, nT, (const double *)map, maxWindowFaces, ratio,
+                                sharedVertices, nWritten, out);
+    }
+    fclose(triangles);
+    
+    if (map != MAP_FAILED) munmap(map, mapSize);
+    fclose(positions);
+    
+    out.flush();
+    if (success && !out) {
+        std::cerr << "Error: Could not write " << outFileName << std::endl;
+        success = false;
+    }
+    
+    return success;
+}
@@ -0,0 +1,35 @@
+#ifndef MESH_STREAM_H
+#define MESH_STREAM_H
+
+#include "Types.h"
+
+class MeshStream {
+public:
+    // simplifies an obj file that need not fit in memory. Faces are bucketed into
+    // slabs along the longest axis of their centroids, with slab boundaries at
+    // centroid quantiles, and each slab is simplified in core with its border
+    // vertices locked and appended to the output file. Slabs that still hold more
+    // than maxWindowFaces faces are split again, so at most about maxWindowFaces
+    // faces are held in memory at once
+    static bool simplify(const std::string& inFileName, const std::string& outFileName,
+                         int target, int maxWindowFaces = 1000000);
+    
+private:
+    // streams vertex positions and fan triangulated faces of an obj file into
+    // binary temporary files
+    static bool split(std::ifstream& in, FILE *positions, FILE *triangles, uint32_t& nV, uint32_t& nT);
+    
+    // buckets the nT triangles in a temporary file into slabs of at most about
+    // maxWindowFaces faces and simplifies them one at a time, recursing into slabs
+    // whose faces could not be separated by the histogram
+    static bool simplifySlabs(FILE *triangles, uint32_t nT, const double *positions, int maxWindowFaces,
+                              double ratio, std::unordered_map<uint32_t, uint32_t>& sharedVertices,
+                              uint32_t& nWritten, std::ofstream& out);
+    
+    // simplifies the triangles of one slab and appends the result to out
+    static void simplifyWindow(const std::vector<uint32_t>& triangles, const double *positions,
+                               double ratio, std::unordered_map<uint32_t, uint32_t>& sharedVertices,
+                               uint32_t& nWritten, std::ofstream& out);
+};
+
+#endif
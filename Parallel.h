@@ -0,0 +1,47 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <algorithm>
+#include "Types.h"
+
+// smallest number of iterations worth handing to a separate thread
+#define PARALLEL_GRAIN_SIZE 1024
+
+// returns number of threads to use, 0 selects all hardware threads
+inline int resolveThreadCount(int threads)
+{
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    return std::max(1, threads);
+}
+
+// calls f(i) for every i in [begin, end), split into one contiguous range per thread
+// with at least grainSize iterations each
+template <typename F>
+void parallelFor(int begin, int end, int threads, const F& f, int grainSize = PARALLEL_GRAIN_SIZE)
+{
+    int n = end - begin;
+    threads = std::min(resolveThreadCount(threads), std::max(1, n / std::max(1, grainSize)));
+    
+    if (threads == 1) {
+        for (int i = begin; i < end; i++) f(i);
+        return;
+    }
+    
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (int t = 0; t < threads; t++) {
+        int first = begin + (int)((long long)n * t / threads);
+        int last = begin + (int)((long long)n * (t + 1) / threads);
+        
+        workers.push_back(std::thread([first, last, &f]() {
+            for (int i = first; i < last; i++) f(i);
+        }));
+    }
+    
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+}
+
+#endif
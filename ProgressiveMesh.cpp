@@ -0,0 +1,171 @@
+#include "ProgressiveMesh.h"
+#include "Mesh.h"
+#include "MeshIO.h"
+
+ProgressiveMesh::ProgressiveMesh():
+currentLevel(0),
+nFaces(0)
+{
+    cornerOffsets.push_back(0);
+}
+
+void ProgressiveMesh::clear()
+{
+    splits.clear();
+    cornerOffsets.assign(1, 0);
+    corners.clear();
+    positions.clear();
+    faceVertices.clear();
+    faceActive.clear();
+    currentLevel = 0;
+    nFaces = 0;
+}
+
+bool ProgressiveMesh::build(const Mesh& mesh)
+{
+    clear();
+    
+    positions.resize(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        positions[i] = mesh.vertices[i].position;
+    }
+    
+    // boundary faces stay inactive at every level
+    faceVertices.assign(3*mesh.faces.size(), -1);
+    faceActive.assign(mesh.faces.size(), false);
+    for (size_t i = 0; i < mesh.faces.size(); i++) {
+        if (mesh.faces[i].isBoundary(mesh)) continue;
+        
+        HalfEdgeHandle fHe = mesh.faceHe[i];
+        HalfEdgeHandle h = fHe;
+        int k = 0;
+        do {
+            if (k == 3) {
+                clear();
+                return false;
+            }
+            
+            faceVertices[3*i + k++] = (int)mesh.vertex(h).index;
+            
+            h = mesh.next(h);
+        } while (h != fHe);
+        
+        faceActive[i] = true;
+        nFaces++;
+    }
+    
+    return true;
+}
+
+void ProgressiveMesh::recordCollapse(const Mesh& mesh, EdgeHandle e, const Vector3s& position)
+{
+    HalfEdgeHandle eHe = mesh.he(e);
+    HalfEdgeHandle flip = mesh.flip(eHe);
+    
+    VertexSplit split;
+    split.vertex = (int)mesh.vertex(eHe).index;
+    split.removedVertex = (int)mesh.vertex(flip).index;
+    split.faces[0] = mesh.halfEdges[eHe.index].onBoundary ? -1 : (int)mesh.face(eHe).index;
+    split.faces[1] = mesh.halfEdges[flip.index].onBoundary ? -1 : (int)mesh.face(flip).index;
+    split.position = positions[split.vertex];
+    split.collapsedPosition = position;
+    
+    // corners of the removed vertex get relabeled to the surviving vertex
+    HalfEdgeHandle h = flip;
+    do {
+        if (!mesh.halfEdges[h.index].onBoundary) {
+            int f = (int)mesh.face(h).index;
+            for (int k = 0; k < 3; k++) {
+                if (faceVertices[3*f + k] == split.removedVertex) corners.push_back(3*f + k);
+            }
+        }
+        
+        h = mesh.next(mesh.flip(h));
+    } while (h != flip);
+    
+    splits.push_back(split);
+    cornerOffsets.push_back((int)corners.size());
+    
+    coarsen();
+}
+
+void ProgressiveMesh::coarsen()
+{
+    const VertexSplit& split = splits[currentLevel];
+    
+    positions[split.vertex] = split.collapsedPosition;
+    for (int i = cornerOffsets[currentLevel]; i < cornerOffsets[currentLevel+1]; i++) {
+        faceVertices[corners[i]] = split.vertex;
+    }
+    
+    for (int i = 0; i < 2; i++) {
+        if (split.faces[i] >= 0) {
+            faceActive[split.faces[i]] = false;
+            nFaces--;
+        }
+    }
+    
+    currentLevel++;
+}
+
+void ProgressiveMesh::refine()
+{
+    currentLevel--;
+    
+    const VertexSplit& split = splits[currentLevel];
+    
+    positions[split.vertex] = split.position;
+    for (int i = cornerOffsets[currentLevel]; i < cornerOffsets[currentLevel+1]; i++) {
+        faceVertices[corners[i]] = split.removedVertex;
+    }
+    
+    for (int i = 0; i < 2; i++) {
+        if (split.faces[i] >= 0) {
+            faceActive[split.faces[i]] = true;
+            nFaces++;
+        }
+    }
+}
+
+void ProgressiveMesh::setLevel(int level)
+{
+    level = std::max(0, std::min(level, levels()));
+    
+    while (currentLevel < level) coarsen();
+    while (currentLevel > level) refine();
+}
+
+// returns the number of faces removed by split
+inline int removedFaces(const VertexSplit& split)
+{
+    return (split.faces[0] >= 0) + (split.faces[1] >= 0);
+}
+
+void ProgressiveMesh::setFaceCount(int target)
+{
+    while (currentLevel < levels() && nFaces > target) coarsen();
+    while (currentLevel > 0 && nFaces + removedFaces(splits[currentLevel-1]) <= target) refine();
+}
+
+bool ProgressiveMesh::extract(Mesh& mesh) const
+{
+    // number the vertices referenced by active faces
+    std::vector<int> remap(positions.size(), -1);
+    MeshData data;
+    for (size_t i = 0; i < faceActive.size(); i++) {
+        if (!faceActive[i]) continue;
+        
+        for (int k = 0; k < 3; k++) {
+            int v = faceVertices[3*i + k];
+            if (remap[v] < 0) {
+                remap[v] = (int)data.positions.size();
+                data.positions.push_back(positions[v]);
+            }
+            
+            data.indices.push_back(Index(remap[v], -1, -1));
+        }
+        data.endFace();
+    }
+    
+    return MeshIO::buildMesh(data, mesh);
+}
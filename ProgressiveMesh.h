@@ -0,0 +1,84 @@
+#ifndef PROGRESSIVE_MESH_H
+#define PROGRESSIVE_MESH_H
+
+#include "Types.h"
+
+class VertexSplit {
+public:
+    // vertex that survives the collapse
+    int vertex;
+    
+    // vertex merged into the surviving vertex
+    int removedVertex;
+    
+    // faces removed by the collapse, -1 for boundary faces
+    int faces[2];
+    
+    // surviving vertex position before and after the collapse
+    Vector3s position;
+    Vector3s collapsedPosition;
+};
+
+// Records a sequence of edge collapses over the triangles of a mesh. Any level
+// between the original mesh and the coarsest recorded one can be reached by
+// applying or undoing collapses, in time proportional to the number of corners
+// they relabel
+class ProgressiveMesh {
+public:
+    // default constructor
+    ProgressiveMesh();
+    
+    // sets the original mesh as the finest level and discards recorded collapses.
+    // Returns false if a face is not a triangle
+    bool build(const Mesh& mesh);
+    
+    // records the collapse of edge e into position and applies it. Must be called
+    // before the mesh is modified, with the current level being the coarsest
+    void recordCollapse(const Mesh& mesh, EdgeHandle e, const Vector3s& position);
+    
+    // discards all levels
+    void clear();
+    
+    // returns the number of recorded collapses
+    int levels() const { return (int)splits.size(); }
+    
+    // returns the number of collapses currently applied
+    int level() const { return currentLevel; }
+    
+    // returns the number of faces at the current level
+    int faceCount() const { return nFaces; }
+    
+    // applies or undoes collapses until level collapses are applied
+    void setLevel(int level);
+    
+    // moves to the finest level with at most target faces, or to the coarsest
+    // level if no level has that few
+    void setFaceCount(int target);
+    
+    // builds the mesh at the current level
+    bool extract(Mesh& mesh) const;
+    
+    // collapse records in the order they were applied. The corners relabeled by
+    // split i are corners[cornerOffsets[i], cornerOffsets[i+1])
+    std::vector<VertexSplit> splits;
+    std::vector<int> cornerOffsets;
+    std::vector<int> corners;
+    
+    // current level, face f spans corners 3f to 3f + 2
+    std::vector<Vector3s> positions;
+    std::vector<int> faceVertices;
+    std::vector<char> faceActive;
+    
+private:
+    // applies the next collapse
+    void coarsen();
+    
+    // undoes the last applied collapse
+    void refine();
+    
+    // member variables
+    int currentLevel;
+    int nFaces;
+};
+
+#endif
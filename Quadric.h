@@ -0,0 +1,114 @@
+#ifndef QUADRIC_H
+#define QUADRIC_H
+
+#include "Types.h"
+
+// symmetric 4x4 quadric error metric storing only its upper triangle:
+// a00 a01 a02 a03 a11 a12 a13 a22 a23 a33
+template <typename T>
+class QuadricT {
+public:
+    // default constructor, creates a zero quadric
+    QuadricT() { setZero(); }
+    
+    // constructs the fundamental quadric of plane ax + by + cz + d = 0
+    explicit QuadricT(const Eigen::Vector4d& plane)
+    {
+        const double a = plane[0], b = plane[1], c = plane[2], d = plane[3];
+        
+        q[0] = (T)(a*a); q[1] = (T)(a*b); q[2] = (T)(a*c); q[3] = (T)(a*d);
+        q[4] = (T)(b*b); q[5] = (T)(b*c); q[6] = (T)(b*d);
+        q[7] = (T)(c*c); q[8] = (T)(c*d);
+        q[9] = (T)(d*d);
+    }
+    
+    // sets all coefficients to zero
+    void setZero()
+    {
+        for (int i = 0; i < 10; i++) q[i] = 0;
+    }
+    
+    // accumulates quadric
+    QuadricT& operator+=(const QuadricT& quadric)
+    {
+        for (int i = 0; i < 10; i++) q[i] += quadric.q[i];
+        return *this;
+    }
+    
+    // returns sum of quadrics
+    QuadricT operator+(const QuadricT& quadric) const
+    {
+        QuadricT sum = *this;
+        sum += quadric;
+        return sum;
+    }
+    
+    // scales quadric
+    QuadricT& operator*=(double s)
+    {
+        for (int i = 0; i < 10; i++) q[i] = (T)(q[i]*s);
+        return *this;
+    }
+    
+    // returns scaled quadric
+    QuadricT operator*(double s) const
+    {
+        QuadricT scaled = *this;
+        scaled *= s;
+        return scaled;
+    }
+    
+    // returns error x^T Q x at point (x, y, z, 1)
+    double evaluate(const Eigen::Vector3d& p) const
+    {
+        const double x = p.x(), y = p.y(), z = p.z();
+        
+        return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x +
+               q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y +
+               q[7]*z*z + 2*q[8]*z +
+               q[9];
+    }
+    
+    // finds the point of least error by solving A x = -b, where A is the upper
+    // left 3x3 block and b the last column, with the closed form inverse from
+    // cofactors. Returns false if the system is singular or badly conditioned
+    bool minimize(Eigen::Vector3d& p) const
+    {
+        const double a00 = q[0], a01 = q[1], a02 = q[2];
+        const double a11 = q[4], a12 = q[5], a22 = q[7];
+        
+        const double c00 = a11*a22 - a12*a12;
+        const double c01 = a02*a12 - a01*a22;
+        const double c02 = a01*a12 - a02*a11;
+        const double det = a00*c00 + a01*c01 + a02*c02;
+        
+        const double scale = fmax(fabs(a00), fmax(fabs(a11), fabs(a22)));
+        if (fabs(det) <= 1e-6 || fabs(det) <= 1e-12*scale*scale*scale) {
+            return false;
+        }
+        
+        const double c11 = a00*a22 - a02*a02;
+        const double c12 = a01*a02 - a00*a12;
+        const double c22 = a00*a11 - a01*a01;
+        
+        const double b0 = q[3], b1 = q[6], b2 = q[8];
+        const double s = -1.0 / det;
+        p << s*(c00*b0 + c01*b1 + c02*b2),
+             s*(c01*b0 + c11*b1 + c12*b2),
+             s*(c02*b0 + c12*b1 + c22*b2);
+        
+        return true;
+    }
+    
+    // packed upper triangle
+    T q[10];
+};
+
+// storage precision for vertex quadrics, define FLOAT_QUADRICS to halve their size
+#ifdef FLOAT_QUADRICS
+typedef QuadricT<float> Quadric;
+#else
+typedef QuadricT<double> Quadric;
+#endif
+
+#endif
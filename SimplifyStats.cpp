@@ -0,0 +1,46 @@
+#include "SimplifyStats.h"
+#include <sstream>
+
+SimplifyStats::SimplifyStats()
+{
+    clear();
+}
+
+void SimplifyStats::clear()
+{
+    initialFaces = 0;
+    faces = 0;
+    collapses = 0;
+    rejectedCollapses = 0;
+    stalePops = 0;
+    heapUpdates = 0;
+    costRecomputes = 0;
+    rounds = 0;
+    clusterCollapses = 0;
+    lastError = 0;
+    maxError = 0;
+    quadricTime = 0;
+    clusterTime = 0;
+    costTime = 0;
+    heapTime = 0;
+    collapseTime = 0;
+    compactTime = 0;
+}
+
+std::string SimplifyStats::summary() const
+{
+    std::stringstream ss;
+    ss << "faces " << initialFaces << " -> " << faces
+       << ", collapses " << collapses << ", rejected " << rejectedCollapses
+       << ", stale " << stalePops << ", heap updates " << heapUpdates
+       << ", cost recomputes " << costRecomputes;
+    if (rounds > 0) ss << ", rounds " << rounds;
+    if (clusterCollapses > 0) ss << ", cluster collapses " << clusterCollapses;
+    ss << ", max error " << maxError
+       << ", time quadrics " << quadricTime << "s, clustering " << clusterTime
+       << "s, costs " << costTime
+       << "s, heap " << heapTime << "s, collapses " << collapseTime
+       << "s, compaction " << compactTime << "s";
+    
+    return ss.str();
+}
@@ -0,0 +1,49 @@
+#ifndef SIMPLIFY_STATS_H
+#define SIMPLIFY_STATS_H
+
+#include "Types.h"
+
+class SimplifyStats {
+public:
+    // default constructor
+    SimplifyStats();
+    
+    // resets counters and timings
+    void clear();
+    
+    // returns a one line description of the counters and timings
+    std::string summary() const;
+    
+    // face counts before simplification and after the latest collapse
+    int initialFaces;
+    int faces;
+    
+    // applied collapses, collapses rejected by validCollapse, heap entries of
+    // already removed edges, heap insertions and updates, and collapse cost evaluations
+    int collapses;
+    int rejectedCollapses;
+    int stalePops;
+    int heapUpdates;
+    int costRecomputes;
+    
+    // batches collapsed by simplifyParallel
+    int rounds;
+    
+    // collapses made by vertex clustering before the heap is built
+    int clusterCollapses;
+    
+    // quadric error of the latest and the most expensive applied collapse
+    double lastError;
+    double maxError;
+    
+    // wall time in seconds spent computing quadrics, clustering vertices, computing
+    // collapse costs, building the heap, collapsing edges and compacting the mesh
+    double quadricTime;
+    double clusterTime;
+    double costTime;
+    double heapTime;
+    double collapseTime;
+    double compactTime;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+// returns seconds elapsed since start
+inline double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+#endif
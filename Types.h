@@ -2,6 +2,7 @@
 #define TYPES_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -9,7 +10,6 @@
 #include "math.h"
 #include <Eigen/Core>
 #include <Eigen/Dense>
-#include <boost/heap/fibonacci_heap.hpp>
 
 class Vertex;
 class Edge;
@@ -18,6 +18,42 @@ class HalfEdge;
 class Mesh;
 class MeshIO;
 
+// compact 32-bit reference to a mesh element
+template <typename T>
+class Handle {
+public:
+    // default constructor, creates an invalid handle
+    Handle(): index(0xffffffff) {}
+    
+    // constructs handle from element index
+    explicit Handle(uint32_t index_): index(index_) {}
+    
+    // checks if handle refers to an element
+    bool isValid() const { return index != 0xffffffff; }
+    
+    // comparators
+    bool operator==(const Handle& h) const { return index == h.index; }
+    bool operator!=(const Handle& h) const { return index != h.index; }
+    bool operator<(const Handle& h) const { return index < h.index; }
+    
+    // id between 0 and |T|-1
+    uint32_t index;
+};
+
+// storage precision for positions, uvs and normals, define FLOAT_POSITIONS to halve
+// their size. Quadrics, collapse costs and placement are still computed in double
+#ifdef FLOAT_POSITIONS
+typedef float Scalar;
+#else
+typedef double Scalar;
+#endif
+typedef Eigen::Matrix<Scalar, 3, 1> Vector3s;
+
+typedef Handle<HalfEdge> HalfEdgeHandle;
+typedef Handle<Vertex> VertexHandle;
+typedef Handle<Edge> EdgeHandle;
+typedef Handle<Face> FaceHandle;
+
 typedef std::vector<HalfEdge>::iterator HalfEdgeIter;
 typedef std::vector<HalfEdge>::const_iterator HalfEdgeCIter;
 typedef std::vector<Vertex>::iterator VertexIter;
@@ -26,7 +62,7 @@ typedef std::vector<Edge>::iterator EdgeIter;
 typedef std::vector<Edge>::const_iterator EdgeCIter;
 typedef std::vector<Face>::iterator FaceIter;
 typedef std::vector<Face>::const_iterator FaceCIter;
-typedef std::vector<Eigen::Vector3d>::iterator VectorIter;
-typedef std::vector<Eigen::Vector3d>::const_iterator VectorCIter;
+typedef std::vector<Vector3s>::iterator VectorIter;
+typedef std::vector<Vector3s>::const_iterator VectorCIter;
 
 #endif
@@ -0,0 +1,40 @@
+#include "Validation.h"
+#include <sstream>
+
+ValidationReport::ValidationReport()
+{
+    clear();
+}
+
+void ValidationReport::clear()
+{
+    level = VALIDATION_OFF;
+    isolatedVertices.clear();
+    nonManifoldVertices.clear();
+    degenerateFaces.clear();
+    invalidHalfEdges = 0;
+    invalidVertices = 0;
+    invalidEdges = 0;
+    invalidFaces = 0;
+}
+
+bool ValidationReport::isValid() const
+{
+    return isolatedVertices.empty() && nonManifoldVertices.empty() && degenerateFaces.empty() &&
+           invalidHalfEdges == 0 && invalidVertices == 0 && invalidEdges == 0 && invalidFaces == 0;
+}
+
+std::string ValidationReport::summary() const
+{
+    std::stringstream ss;
+    if (!isolatedVertices.empty()) ss << isolatedVertices.size() << " isolated vertices, ";
+    if (!nonManifoldVertices.empty()) ss << nonManifoldVertices.size() << " nonmanifold vertices, ";
+    if (!degenerateFaces.empty()) ss << degenerateFaces.size() << " degenerate faces, ";
+    if (invalidHalfEdges > 0) ss << invalidHalfEdges << " invalid halfedges, ";
+    if (invalidVertices > 0) ss << invalidVertices << " invalid vertices, ";
+    if (invalidEdges > 0) ss << invalidEdges << " invalid edges, ";
+    if (invalidFaces > 0) ss << invalidFaces << " invalid faces, ";
+    
+    std::string s = ss.str();
+    return s.empty() ? "no problems found" : s.substr(0, s.size() - 2);
+}
@@ -0,0 +1,51 @@
+#ifndef VALIDATION_H
+#define VALIDATION_H
+
+#include "Types.h"
+
+// checks run on meshes after they are read
+enum ValidationLevel {
+    // no checks
+    VALIDATION_OFF,
+    
+    // isolated and nonmanifold vertices
+    VALIDATION_FAST,
+    
+    // fast checks plus halfedge connectivity invariants and degenerate faces
+    VALIDATION_FULL
+};
+
+class ValidationReport {
+public:
+    // default constructor
+    ValidationReport();
+    
+    // resets report
+    void clear();
+    
+    // checks if no problems were found
+    bool isValid() const;
+    
+    // returns a one line description of the problems found
+    std::string summary() const;
+    
+    // level the report was produced with
+    ValidationLevel level;
+    
+    // vertices not contained in any face
+    std::vector<int> isolatedVertices;
+    
+    // vertices whose faces do not form a single fan
+    std::vector<int> nonManifoldVertices;
+    
+    // faces that visit a vertex more than once
+    std::vector<int> degenerateFaces;
+    
+    // number of elements whose connectivity violates the halfedge invariants
+    int invalidHalfEdges;
+    int invalidVertices;
+    int invalidEdges;
+    int invalidFaces;
+};
+
+#endif
@@ -1,36 +1,36 @@
 #include "Vertex.h"
-#include "HalfEdge.h"
+#include "Mesh.h"
 
-std::vector<HalfEdge> isolated;
-
-bool Vertex::isIsolated() const
+bool Vertex::isIsolated(const Mesh& mesh) const
 {
-    return he == isolated.begin();
+    return !mesh.he(VertexHandle(index)).isValid();
 }
 
-bool Vertex::onBoundary() const
+bool Vertex::onBoundary(const Mesh& mesh) const
 {
-    HalfEdgeCIter h = he;
+    HalfEdgeHandle he = mesh.he(VertexHandle(index));
+    HalfEdgeHandle h = he;
     do {
-        if (h->onBoundary) {
+        if (mesh.halfEdges[h.index].onBoundary) {
             return true;
         }
         
-        h = h->flip->next;
+        h = mesh.next(mesh.flip(h));
     } while (h != he);
     
     return false;
 }
 
-bool Vertex::shareEdge(VertexCIter v) const
+bool Vertex::shareEdge(const Mesh& mesh, VertexHandle v) const
 {
-    HalfEdgeCIter h = he;
+    HalfEdgeHandle he = mesh.he(VertexHandle(index));
+    HalfEdgeHandle h = he;
     do {
-        if (h->flip->vertex == v) {
+        if (mesh.vertex(mesh.flip(h)) == v) {
             return true;
         }
         
-        h = h->flip->next;
+        h = mesh.next(mesh.flip(h));
     } while (h != he);
     
     return false;
@@ -2,14 +2,12 @@
 #define VERTEX_H
 
 #include "Types.h"
+#include "Quadric.h"
 
 class Vertex {
 public:
-    // outgoing halfedge
-    HalfEdgeIter he;
-    
     // location in 3d
-    Eigen::Vector3d position;
+    Vector3s position;
     
     // id between 0 and |V|-1
     int index;
@@ -17,17 +15,23 @@ public:
     // flag for removal
     bool remove;
     
+    // excludes vertex from collapses
+    bool locked;
+    
+    // cached result of onBoundary, kept up to date by Edge::collapse
+    bool boundary;
+    
     // quadric error metric
-    Eigen::Matrix4d quadric;
+    Quadric quadric;
     
     // checks if vertex is contained in any edge or face
-    bool isIsolated() const;
+    bool isIsolated(const Mesh& mesh) const;
     
     // checks if v is on boundary
-    bool onBoundary() const;
+    bool onBoundary(const Mesh& mesh) const;
     
     // checks if vertices share an edge
-    bool shareEdge(VertexCIter v) const;
+    bool shareEdge(const Mesh& mesh, VertexHandle v) const;
 };
 
 #endif
@@ -0,0 +1,396 @@
+#include <sstream>
+#include <thread>
+#include "Mesh.h"
+#include "MeshIO.h"
+#include "Timer.h"
+
+class Timings {
+public:
+    Timings(): load(INFINITY), quadrics(INFINITY), clustering(INFINITY),
+               costs(INFINITY), heap(INFINITY),
+               collapse(INFINITY), compaction(INFINITY), write(INFINITY), total(INFINITY) {}
+    
+    // keeps the faster time of each phase
+    void keepMin(const Timings& t) {
+        load = std::min(load, t.load);
+        quadrics = std::min(quadrics, t.quadrics);
+        clustering = std::min(clustering, t.clustering);
+        costs = std::min(costs, t.costs);
+        heap = std::min(heap, t.heap);
+        collapse = std::min(collapse, t.collapse);
+        compaction = std::min(compaction, t.compaction);
+        write = std::min(write, t.write);
+        total = std::min(total, t.total);
+    }
+    
+    double load, quadrics, clustering, costs, heap, collapse, compaction, write, total;
+};
+
+class Result {
+public:
+    std::string name;
+    int vertices;
+    int faces;
+    int target;
+    int finalFaces;
+    Timings timings;
+};
+
+// integer hash used for reproducible noise, independent of the standard library
+inline double hashNoise(uint32_t x, uint32_t y, uint32_t seed)
+{
+    uint32_t h = x*0x8da6b343u ^ y*0xd8163841u ^ seed*0xcb1ab31fu;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    
+    return (double)h / 4294967295.0;
+}
+
+// bilinearly interpolated value noise with integer lattice spacing cell
+double valueNoise(int x, int y, int cell, uint32_t seed)
+{
+    int cx = x / cell, cy = y / cell;
+    double u = (double)(x % cell) / cell, v = (double)(y % cell) / cell;
+    
+    double a = hashNoise(cx, cy, seed), b = hashNoise(cx + 1, cy, seed);
+    double c = hashNoise(cx, cy + 1, seed), d = hashNoise(cx + 1, cy + 1, seed);
+    
+    return (a*(1 - u) + b*u)*(1 - v) + (c*(1 - u) + d*u)*v;
+}
+
+// grid of n x n vertices with several octaves of noise plus per vertex jitter
+void generateHeightField(int n, MeshData& data)
+{
+    data = MeshData();
+    data.positions.reserve((size_t)n*n);
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            double z = 0, amplitude = 0.25;
+            for (int cell = std::max(2, n/4), octave = 0; cell >= 2; cell /= 2, octave++) {
+                z += amplitude*valueNoise(x, y, cell, octave);
+                amplitude *= 0.5;
+            }
+            z += 0.002*hashNoise(x, y, 1000);
+            
+            data.positions.push_back(Vector3s((double)x/(n - 1), (double)y/(n - 1), z));
+        }
+    }
+    
+    data.indices.reserve(6*(size_t)(n - 1)*(n - 1));
+    data.faceOffsets.reserve(2*(size_t)(n - 1)*(n - 1) + 1);
+    for (int y = 0; y < n - 1; y++) {
+        for (int x = 0; x < n - 1; x++) {
+            int a = y*n + x, b = a + 1, c = a + n, d = c + 1;
+            
+            data.indices.push_back(Index(a, -1, -1));
+            data.indices.push_back(Index(b, -1, -1));
+            data.indices.push_back(Index(d, -1, -1));
+            data.endFace();
+            
+            data.indices.push_back(Index(a, -1, -1));
+            data.indices.push_back(Index(d, -1, -1));
+            data.indices.push_back(Index(c, -1, -1));
+            data.endFace();
+        }
+    }
+}
+
+// icosahedron subdivided levels times, with vertices projected onto the unit sphere
+void generateSphere(int levels, MeshData& data)
+{
+    const double t = (1.0 + sqrt(5.0)) / 2.0;
+    const double p[12][3] = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0}, {0, -1, t}, {0, 1, t},
+                             {0, -1, -t}, {0, 1, -t}, {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+    const int f[20][3] = {{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11}, {1, 5, 9},
+                          {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8}, {3, 9, 4}, {3, 4, 2},
+                          {3, 2, 6}, {3, 6, 8}, {3, 8, 9}, {4, 9, 5}, {2, 4, 11}, {6, 2, 10},
+                          {8, 6, 7}, {9, 8, 1}};
+    
+    std::vector<Vector3s> positions;
+    std::vector<int> triangles;
+    for (int i = 0; i < 12; i++) positions.push_back(Vector3s(p[i][0], p[i][1], p[i][2]).normalized());
+    for (int i = 0; i < 20; i++) triangles.insert(triangles.end(), f[i], f[i] + 3);
+    
+    for (int level = 0; level < levels; level++) {
+        std::unordered_map<uint64_t, int> midpoints;
+        std::vector<int> subdivided;
+        subdivided.reserve(4*triangles.size());
+        
+        for (size_t i = 0; i < triangles.size(); i += 3) {
+            int m[3];
+            for (int k = 0; k < 3; k++) {
+                int a = triangles[i + k], b = triangles[i + (k + 1)%3];
+                uint64_t key = ((uint64_t)std::min(a, b) << 32) | (uint64_t)std::max(a, b);
+                
+                std::unordered_map<uint64_t, int>::iterator it = midpoints.find(key);
+                if (it == midpoints.end()) {
+                    it = midpoints.insert(std::make_pair(key, (int)positions.size())).first;
+                    positions.push_back((positions[a] + positions[b]).normalized());
+                }
+                m[k] = it->second;
+            }
+            
+            int c[12] = {triangles[i], m[0], m[2], m[0], triangles[i + 1], m[1],
+                         m[2], m[1], triangles[i + 2], m[0], m[1], m[2]};
+            subdivided.insert(subdivided.end(), c, c + 12);
+        }
+        
+        triangles.swap(subdivided);
+    }
+    
+    data = MeshData();
+    data.positions.swap(positions);
+    data.indices.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        for (int k = 0; k < 3; k++) data.indices.push_back(Index(triangles[i + k], -1, -1));
+        data.endFace();
+    }
+}
+
+// writes positions and faces of data as an obj file
+bool writeObj(const std::string& fileName, const MeshData& data)
+{
+    FILE *out = fopen(fileName.c_str(), "wb");
+    if (!out) return false;
+    
+    for (size_t i = 0; i < data.positions.size(); i++) {
+        const Vector3s& p = data.positions[i];
+        fprintf(out, "v %.9g %.9g %.9g\n", p.x(), p.y(), p.z());
+    }
+    
+    for (int f = 0; f < data.nFaces(); f++) {
+        fputc('f', out);
+        for (int k = 0; k < data.faceSize(f); k++) fprintf(out, " %d", data.face(f)[k].position + 1);
+        fputc('\n', out);
+    }
+    
+    return fclose(out) == 0;
+}
+
+// times every phase of loading, simplifying and writing an obj file
+bool run(const std::string& fileName, const std::string& outFileName, double ratio, double tolerance,
+         double clusterFactor, int threads, Result& result)
+{
+    Timings t;
+    Clock::time_point begin = Clock::now();
+    
+    // load through the same entry point as simplify, which parses, builds connectivity
+    // and normalizes the mesh
+    Mesh mesh;
+    mesh.threads = threads;
+    mesh.clusterFactor = clusterFactor;
+    Clock::time_point start = Clock::now();
+    if (!mesh.read(fileName)) return false;
+    t.load = secondsSince(start);
+    
+    result.vertices = (int)mesh.vertices.size();
+    result.faces = 0;
+    for (size_t i = 0; i < mesh.faces.size(); i++) {
+        if (!mesh.faces[i].isBoundary(mesh)) result.faces++;
+    }
+    result.target = (int)(ratio*result.faces);
+    
+    // simplify
+    if (tolerance > 0) mesh.simplifyParallel(result.target, tolerance);
+    else mesh.simplify(result.target);
+    
+    t.quadrics = mesh.stats.quadricTime;
+    t.clustering = mesh.stats.clusterTime;
+    t.costs = mesh.stats.costTime;
+    t.heap = mesh.stats.heapTime;
+    t.collapse = mesh.stats.collapseTime;
+    t.compaction = mesh.stats.compactTime;
+    result.finalFaces = 0;
+    for (size_t i = 0; i < mesh.faces.size(); i++) {
+        if (!mesh.faces[i].isBoundary(mesh)) result.finalFaces++;
+    }
+    
+    // write
+    start = Clock::now();
+    if (!mesh.write(outFileName)) return false;
+    t.write = secondsSince(start);
+    
+    t.total = secondsSince(begin);
+    result.timings.keepMin(t);
+    
+    return true;
+}
+
+void printCsv(const std::vector<Result>& results, int threads, double tolerance)
+{
+    std::cout << "mesh,vertices,faces,target,final_faces,threads,tolerance,"
+              << "load,quadrics,clustering,costs,heap,collapse,compaction,write,total\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        const Timings& t = r.timings;
+        std::cout << r.name << "," << r.vertices << "," << r.faces << "," << r.target << ","
+                  << r.finalFaces << "," << threads << "," << tolerance << ","
+                  << t.load << "," << t.quadrics << "," << t.clustering << ","
+                  << t.costs << ","
+                  << t.heap << "," << t.collapse << "," << t.compaction << "," << t.write << ","
+                  << t.total << "\n";
+    }
+}
+
+// escapes quotes, backslashes and control characters for a json string
+std::string jsonEscape(const std::string& s)
+{
+    std::string escaped;
+    escaped.reserve(s.size());
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += (char)c;
+            
+        } else if (c < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            escaped += buffer;
+            
+        } else {
+            escaped += (char)c;
+        }
+    }
+    
+    return escaped;
+}
+
+void printJson(const std::vector<Result>& results, int threads, double tolerance)
+{
+    std::cout << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        const Timings& t = r.timings;
+        std::cout << "  {\"mesh\": \"" << jsonEscape(r.name) << "\", \"vertices\": " << r.vertices
+                  << ", \"faces\": " << r.faces << ", \"target\": " << r.target
+                  << ", \"final_faces\": " << r.finalFaces << ", \"threads\": " << threads
+                  << ", \"tolerance\": " << tolerance << ", \"load\": " << t.load
+                  << ", \"quadrics\": " << t.quadrics
+                  << ", \"clustering\": " << t.clustering
+                  << ", \"costs\": " << t.costs << ", \"heap\": " << t.heap
+                  << ", \"collapse\": " << t.collapse << ", \"compaction\": " << t.compaction
+                  << ", \"write\": " << t.write << ", \"total\": " << t.total << "}"
+                  << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    std::cout << "]" << std::endl;
+}
+
+void printUsage()
+{
+    std::cerr << "usage: benchmark [options] [obj files]\n"
+              << "  --max-faces N     largest generated mesh, up to 50000000 (default 1000000)\n"
+              << "  --no-generated    only run the given obj files\n"
+              << "  --ratio R         target as a fraction of the input faces (default 0.1)\n"
+              << "  --parallel TOL    use simplifyParallel with tolerance TOL\n"
+              << "  --cluster F       cluster vertices down to F * target faces first\n"
+              << "  --threads N       number of threads, 0 uses all hardware threads (default 0)\n"
+              << "  --repeat N        runs per mesh, the fastest time of each phase is kept (default 1)\n"
+              << "  --format F        csv or json (default csv)\n"
+              << "  --tmp DIR         directory for generated and simplified files (default /tmp)\n"
+              << "bunny.obj is run when no obj files are given" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int maxFaces = 1000000;
+    bool generated = true;
+    double ratio = 0.1;
+    double tolerance = 0;
+    double clusterFactor = 0;
+    int threads = 0;
+    int repeat = 1;
+    std::string format = "csv";
+    std::string tmp = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    std::vector<std::string> files;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        
+        if (arg == "--max-faces" && hasValue) maxFaces = atoi(argv[++i]);
+        else if (arg == "--no-generated") generated = false;
+        else if (arg == "--ratio" && hasValue) ratio = atof(argv[++i]);
+        else if (arg == "--parallel" && hasValue) tolerance = atof(argv[++i]);
+        else if (arg == "--cluster" && hasValue) clusterFactor = atof(argv[++i]);
+        else if (arg == "--threads" && hasValue) threads = atoi(argv[++i]);
+        else if (arg == "--repeat" && hasValue) repeat = std::max(1, atoi(argv[++i]));
+        else if (arg == "--format" && hasValue) format = argv[++i];
+        else if (arg == "--tmp" && hasValue) tmp = argv[++i];
+        else if (arg[0] != '-') files.push_back(arg);
+        else {
+            printUsage();
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+    
+    if (format != "csv" && format != "json") {
+        printUsage();
+        return 1;
+    }
+    
+    // cases are named after their source, generated meshes are written to obj first
+    std::vector<std::pair<std::string, std::string>> cases;
+    if (files.empty()) files.push_back("bunny.obj");
+    for (size_t i = 0; i < files.size(); i++) {
+        cases.push_back(std::make_pair(files[i], files[i]));
+    }
+    
+    std::vector<std::string> generatedFiles;
+    if (generated) {
+        for (int levels = 5; 20*(1 << 2*levels) <= maxFaces; levels++) {
+            std::stringstream name;
+            name << "sphere_" << 20*(1 << 2*levels);
+            
+            std::cerr << "generating " << name.str() << std::endl;
+            MeshData data;
+            generateSphere(levels, data);
+            
+            std::string fileName = tmp + "/benchmark_" + name.str() + ".obj";
+            if (!writeObj(fileName, data)) return 1;
+            cases.push_back(std::make_pair(name.str(), fileName));
+            generatedFiles.push_back(fileName);
+        }
+        
+        const int sizes[] = {10000, 100000, 1000000, 10000000, 50000000};
+        for (int i = 0; i < 5 && sizes[i] <= maxFaces; i++) {
+            int n = (int)sqrt(sizes[i]/2.0) + 1;
+            std::stringstream name;
+            name << "heightfield_" << 2*(n - 1)*(n - 1);
+            
+            std::cerr << "generating " << name.str() << std::endl;
+            MeshData data;
+            generateHeightField(n, data);
+            
+            std::string fileName = tmp + "/benchmark_" + name.str() + ".obj";
+            if (!writeObj(fileName, data)) return 1;
+            cases.push_back(std::make_pair(name.str(), fileName));
+            generatedFiles.push_back(fileName);
+        }
+    }
+    
+    std::vector<Result> results;
+    std::string outFileName = tmp + "/benchmark_simplified.obj";
+    for (size_t i = 0; i < cases.size(); i++) {
+        Result result;
+        result.name = cases[i].first;
+        
+        bool success = true;
+        for (int r = 0; r < repeat && success; r++) {
+            std::cerr << "running " << result.name << " (" << r + 1 << "/" << repeat << ")" << std::endl;
+            success = run(cases[i].second, outFileName, ratio, tolerance, clusterFactor, threads, result);
+        }
+        
+        if (success) results.push_back(result);
+    }
+    
+    for (size_t i = 0; i < generatedFiles.size(); i++) remove(generatedFiles[i].c_str());
+    remove(outFileName.c_str());
+    
+    int nThreads = threads > 0 ? threads : (int)std::thread::hardware_concurrency();
+    if (format == "json") printJson(results, nThreads, tolerance);
+    else printCsv(results, nThreads, tolerance);
+    
+    return results.size() == cases.size() ? 0 : 1;
+}
@@ -20,9 +20,11 @@ double z = -2.5;
 int originalFaces = 0;
 int targetFaces = 0;
 
-std::string path = "/Users/rohansawhney/Desktop/developer/C++/simplification/bunny.obj";
+std::string path = "bunny.obj";
 
 Mesh mesh;
+MeshSnapshot original;
+ProgressiveMesh progressiveMesh;
 bool success = true;
 
 void printInstructions()
@@ -50,8 +52,9 @@ void draw()
     glBegin(GL_LINES);
     for (EdgeCIter e = mesh.edges.begin(); e != mesh.edges.end(); e ++) {
     
-        Eigen::Vector3d a = e->he->vertex->position;
-        Eigen::Vector3d b = e->he->flip->vertex->position;
+        HalfEdgeHandle he = mesh.he(EdgeHandle(e->index));
+        const Vector3s& a = mesh.vertices[mesh.vertex(he).index].position;
+        const Vector3s& b = mesh.vertices[mesh.vertex(mesh.flip(he)).index].position;
             
         glVertex3d(a.x(), a.y(), a.z());
         glVertex3d(b.x(), b.y(), b.z());
@@ -90,9 +93,9 @@ void keyboard(unsigned char key, int x0, int y0)
         case 27 :
             exit(0);
         case ' ':
-            mesh.read(path);
-            mesh.simplify(targetFaces);
-            mesh.write("/Users/rohansawhney/Desktop/cowhead.obj");
+            progressiveMesh.setFaceCount(targetFaces);
+            progressiveMesh.extract(mesh);
+            mesh.write("simplified.obj");
             break;
         case 'a':
             x -= 0.03;
@@ -107,7 +110,7 @@ void keyboard(unsigned char key, int x0, int y0)
             y -= 0.03;
             break;
         case 'r':
-            mesh.read(path);
+            mesh.restore(original);
             break;
     }
     
@@ -144,10 +147,21 @@ void special(int i, int x0, int y0)
 
 int main(int argc, char** argv) {
 
+    if (argc > 1) path = argv[1];
     success = mesh.read(path);
     originalFaces = (int)mesh.faces.size();
     targetFaces = (int)fmax(100, originalFaces*0.05);
     
+    // simplify once to the coarsest level, targets are then extracted from the record
+    if (success) {
+        mesh.snapshot(original);
+        
+        Mesh coarsest(mesh);
+        coarsest.recordCollapses = true;
+        coarsest.simplify(2);
+        progressiveMesh = coarsest.progressiveMesh;
+    }
+    
     printInstructions();
     glutInitWindowSize(gridX, gridY);
     glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
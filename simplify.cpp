@@ -0,0 +1,160 @@
+#include "Mesh.h"
+#include "MeshStream.h"
+#include "MeshBatch.h"
+#include "Timer.h"
+
+void printUsage()
+{
+    std::cerr << "usage: simplify [options] input output\n"
+              << "       simplify [options] --batch DIR inputs...\n"
+              << "  -t, --target N        target face count\n"
+              << "  -r, --ratio R         target as a fraction of the input faces (default 0.1)\n"
+              << "  -p, --parallel TOL    collapse batches of independent edges, each drawn from\n"
+              << "                        the cheapest TOL * |E| edges\n"
+              << "  -c, --cluster F       merge vertices in grid cells down to F * target faces first\n"
+              << "  -j, --threads N       number of threads, 0 uses all hardware threads (default 0)\n"
+              << "  -s, --stream N        simplify an obj file out of core with windows of at most\n"
+              << "                        N faces, requires --target\n"
+              << "  -v, --validate LEVEL  off, fast or full (default fast)\n"
+              << "  -q, --quiet           do not print statistics\n"
+              << "  -b, --batch DIR       simplify every input by --ratio into DIR, one job per worker\n"
+              << "  -w, --workers N       batch workers, 0 uses all hardware threads (default 0)\n"
+              << "  -m, --memory MB       estimated memory the running batch jobs may use (default no limit)\n"
+              << "input and output may be obj, ply or smesh files" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int target = -1;
+    double ratio = 0.1;
+    double tolerance = -1;
+    double clusterFactor = 0;
+    int threads = 0;
+    int windowFaces = 0;
+    ValidationLevel validationLevel = VALIDATION_FAST;
+    bool quiet = false;
+    std::string batchDirectory;
+    int workers = 0;
+    size_t memoryBudget = 0;
+    std::vector<std::string> files;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        
+        if ((arg == "-t" || arg == "--target") && hasValue) target = atoi(argv[++i]);
+        else if ((arg == "-r" || arg == "--ratio") && hasValue) ratio = atof(argv[++i]);
+        else if ((arg == "-p" || arg == "--parallel") && hasValue) tolerance = atof(argv[++i]);
+        else if ((arg == "-c" || arg == "--cluster") && hasValue) clusterFactor = atof(argv[++i]);
+        else if ((arg == "-j" || arg == "--threads") && hasValue) threads = atoi(argv[++i]);
+        else if ((arg == "-s" || arg == "--stream") && hasValue) windowFaces = atoi(argv[++i]);
+        else if ((arg == "-b" || arg == "--batch") && hasValue) batchDirectory = argv[++i];
+        else if ((arg == "-w" || arg == "--workers") && hasValue) workers = atoi(argv[++i]);
+        else if ((arg == "-m" || arg == "--memory") && hasValue) memoryBudget = (size_t)atol(argv[++i]) << 20;
+        else if ((arg == "-v" || arg == "--validate") && hasValue) {
+            std::string level = argv[++i];
+            if (level == "off") validationLevel = VALIDATION_OFF;
+            else if (level == "fast") validationLevel = VALIDATION_FAST;
+            else if (level == "full") validationLevel = VALIDATION_FULL;
+            else {
+                printUsage();
+                return 1;
+            }
+        
+        } else if (arg == "-q" || arg == "--quiet") quiet = true;
+        else if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        
+        } else if (arg[0] != '-') files.push_back(arg);
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    
+    if (!batchDirectory.empty()) {
+        if (files.empty()) {
+            printUsage();
+            return 1;
+        }
+        
+        if (target >= 0 || windowFaces > 0) {
+            std::cerr << "--batch simplifies by --ratio and cannot be combined with --target or --stream" << std::endl;
+            return 1;
+        }
+        
+        std::vector<BatchJob> jobs;
+        for (size_t i = 0; i < files.size(); i++) {
+            size_t slash = files[i].find_last_of('/');
+            std::string name = slash == std::string::npos ? files[i] : files[i].substr(slash + 1);
+            BatchJob job(files[i], batchDirectory + "/" + name, ratio);
+            job.validationLevel = validationLevel;
+            job.clusterFactor = clusterFactor;
+            job.tolerance = std::max(0.0, tolerance);
+            jobs.push_back(job);
+        }
+        
+        Clock::time_point start = Clock::now();
+        MeshBatch::run(jobs, workers, memoryBudget, threads > 0 ? threads : 1);
+        
+        int failed = 0;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            const BatchJob& job = jobs[i];
+            if (!job.success) {
+                std::cerr << job.inFileName << ": " << job.error << std::endl;
+                failed++;
+                
+            } else if (!quiet) {
+                std::cerr << job.inFileName << ": faces " << job.faces << " -> " << job.finalFaces
+                          << ", read " << job.readTime << "s, simplify " << job.simplifyTime
+                          << "s, write " << job.writeTime << "s" << std::endl;
+            }
+        }
+        
+        if (!quiet) {
+            std::cerr << jobs.size() - failed << " of " << jobs.size() << " meshes simplified in "
+                      << secondsSince(start) << "s" << std::endl;
+        }
+        
+        return failed > 0 ? 1 : 0;
+    }
+    
+    if (files.size() != 2 || (windowFaces > 0 && target < 0)) {
+        printUsage();
+        return 1;
+    }
+    
+    if (windowFaces > 0) {
+        Clock::time_point start = Clock::now();
+        if (!MeshStream::simplify(files[0], files[1], target, windowFaces)) return 1;
+        if (!quiet) std::cerr << "streamed in " << secondsSince(start) << "s" << std::endl;
+        
+        return 0;
+    }
+    
+    Mesh mesh;
+    mesh.threads = threads;
+    mesh.validationLevel = validationLevel;
+    mesh.clusterFactor = clusterFactor;
+    
+    Clock::time_point start = Clock::now();
+    if (!mesh.read(files[0])) return 1;
+    double readTime = secondsSince(start);
+    
+    if (target < 0) target = (int)(ratio*mesh.faces.size());
+    
+    if (tolerance > 0) mesh.simplifyParallel(target, tolerance);
+    else mesh.simplify(target);
+    
+    start = Clock::now();
+    if (!mesh.write(files[1])) return 1;
+    double writeTime = secondsSince(start);
+    
+    if (!quiet) {
+        std::cerr << mesh.stats.summary() << "\n"
+                  << "read " << readTime << "s, write " << writeTime << "s" << std::endl;
+    }
+    
+    return 0;
+}